@@ -1,57 +1,260 @@
 #pragma once
 #include <map>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
 using namespace std::string_literals;
 
+//Конкурентный накопитель "ключ - число": сегменты с открытой адресацией, выровненные по кэш-линии.
+//Add по существующему ключу выполняется под разделяемой блокировкой сегмента атомарным прибавлением,
+//монопольная блокировка нужна только для роста таблицы и удаления
 template <typename Key, typename Value>
 class ConcurrentMap {
 private:
-    struct Bucket {
-        std::mutex mutex;
-        std::map<Key, Value> map;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    enum SlotState : uint8_t {
+        EMPTY,
+        BUSY, //Слот занят потоком, ключ еще записывается
+        FULL,
+        DELETED,
+    };
+
+    struct Slot {
+        std::atomic<uint8_t> state{ EMPTY };
+        Key key{};
+        std::atomic<Value> value{};
     };
+
+    struct alignas(CACHE_LINE_SIZE) Bucket {
+        std::shared_mutex mutex;
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity = 0; //Степень двойки
+        std::atomic<size_t> used{ 0 }; //Занятые слоты, включая удаленные
+    };
+
     std::vector<Bucket> buckets_;
 
 public:
     static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+    static_assert(std::is_arithmetic_v<Value>, "ConcurrentMap accumulates only arithmetic values");
 
-    struct Access {
-        std::lock_guard<std::mutex&> guard;
-        Value& ref_to_value;
+    //Число сегментов по умолчанию равно числу аппаратных потоков
+    ConcurrentMap()
+        : ConcurrentMap(std::max<size_t>(1, std::thread::hardware_concurrency())) {
+    }
+
+    explicit ConcurrentMap(size_t bucket_count) :
+        buckets_(std::max<size_t>(1, bucket_count)) {
+    }
 
-        explicit Access(const Key& key, Bucket& bucket) :
-            guard(bucket.mutex), ref_to_value(bucket.map[key]) {
+    //Атомарное прибавление delta к значению ключа (отсутствующий ключ начинается с нуля)
+    void Add(const Key& key, Value delta) {
+        const uint64_t hash = Hash(key);
+        Bucket& bucket = GetBucket(hash);
+        while (true) {
+            {
+                std::shared_lock guard(bucket.mutex);
+                if (Slot* slot = FindOrInsert(bucket, key, hash)) {
+                    FetchAdd(slot->value, delta);
+                    return;
+                }
+            }
+            Grow(bucket);
         }
-        ~Access() = default;
-    };
+    }
 
-    explicit ConcurrentMap(size_t bucket_count) :
-        buckets_(bucket_count) {
+    //Текущее значение ключа (ноль, если ключа нет)
+    Value Get(const Key& key) const {
+        const uint64_t hash = Hash(key);
+        Bucket& bucket = const_cast<ConcurrentMap*>(this)->GetBucket(hash);
+        std::shared_lock guard(bucket.mutex);
+        const Slot* slot = Find(bucket, key, hash);
+        return slot ? slot->value.load(std::memory_order_relaxed) : Value{};
     }
 
-    Access operator[](const Key& key) {
-        size_t pos = static_cast<uint64_t>(key) % buckets_.size();
-        return Access(key, buckets_[pos]);
+    void erase(const Key& key) {
+        const uint64_t hash = Hash(key);
+        Bucket& bucket = GetBucket(hash);
+        std::lock_guard guard(bucket.mutex);
+        if (Slot* slot = Find(bucket, key, hash)) {
+            slot->state.store(DELETED, std::memory_order_relaxed);
+        }
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        size_t i = 0;
-        while (i < buckets_.size()) {
-            std::lock_guard<std::mutex> guard(buckets_[i].mutex);
-            result.merge(buckets_[i].map);
-            ++i;
+    //Извлечение всех пар в вектор без упорядочивания; сегменты разбираются параллельно, накопитель пустеет.
+    //Вызывается, когда запись в накопитель закончена
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> Drain(ExecutionPolicy&& policy) {
+        std::vector<size_t> offsets(buckets_.size() + 1, 0);
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            offsets[i + 1] = offsets[i] + CountFull(buckets_[i]);
         }
+        std::vector<std::pair<Key, Value>> result(offsets.back());
+        std::for_each(policy, buckets_.begin(), buckets_.end(), [&](Bucket& bucket) {
+            std::lock_guard guard(bucket.mutex);
+            auto out = result.begin() + offsets[&bucket - buckets_.data()];
+            for (size_t i = 0; i < bucket.capacity; ++i) {
+                const Slot& slot = bucket.slots[i];
+                if (slot.state.load(std::memory_order_relaxed) == FULL) {
+                    *out++ = { slot.key, slot.value.load(std::memory_order_relaxed) };
+                }
+            }
+            bucket.slots.reset();
+            bucket.capacity = 0;
+            bucket.used.store(0, std::memory_order_relaxed);
+            });
         return result;
     }
 
-    void erase(const Key& key) {
-        size_t pos = static_cast<uint64_t>(key) % buckets_.size();
-        std::lock_guard<std::mutex> guard(buckets_[pos].mutex);
-        buckets_[pos].map.erase(key);
+    std::vector<std::pair<Key, Value>> Drain() {
+        return Drain(std::execution::par);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() {
+        const auto pairs = Drain();
+        return std::map<Key, Value>(pairs.begin(), pairs.end());
+    }
+
+private:
+    //Перемешивание битов ключа: старшие биты выбирают сегмент, младшие - слот в нем
+    static uint64_t Hash(const Key& key) {
+        uint64_t x = static_cast<uint64_t>(key);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    Bucket& GetBucket(uint64_t hash) {
+        return buckets_[(hash >> 32) % buckets_.size()];
+    }
+
+    static void FetchAdd(std::atomic<Value>& value, Value delta) {
+        if constexpr (std::is_integral_v<Value>) {
+            value.fetch_add(delta, std::memory_order_relaxed);
+        }
+        else {
+            Value expected = value.load(std::memory_order_relaxed);
+            while (!value.compare_exchange_weak(expected, expected + delta, std::memory_order_relaxed)) {
+            }
+        }
+    }
+
+    //Поиск занятого слота с ключом; вызывается под любой блокировкой сегмента
+    static Slot* Find(const Bucket& bucket, const Key& key, uint64_t hash) {
+        const size_t mask = bucket.capacity - 1;
+        for (size_t probe = 0; probe < bucket.capacity; ++probe) {
+            Slot& slot = bucket.slots[(hash + probe) & mask];
+            const uint8_t state = WaitWhileBusy(slot);
+            if (state == EMPTY) {
+                return nullptr;
+            }
+            if (state == FULL && slot.key == key) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    //Поиск слота ключа или захват пустого слота под разделяемой блокировкой.
+    //nullptr - таблицу нужно увеличить
+    static Slot* FindOrInsert(Bucket& bucket, const Key& key, uint64_t hash) {
+        const size_t mask = bucket.capacity - 1;
+        for (size_t probe = 0; probe < bucket.capacity;) {
+            Slot& slot = bucket.slots[(hash + probe) & mask];
+            uint8_t state = WaitWhileBusy(slot);
+            if (state == FULL) {
+                if (slot.key == key) {
+                    return &slot;
+                }
+                ++probe;
+                continue;
+            }
+            if (state == DELETED) {
+                ++probe;
+                continue;
+            }
+            //Слот пуст: место резервируется до захвата, чтобы заполненность не превысила 3/4
+            if (bucket.used.fetch_add(1, std::memory_order_relaxed) + 1 > bucket.capacity / 4 * 3) {
+                bucket.used.fetch_sub(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            if (slot.state.compare_exchange_strong(state, BUSY, std::memory_order_acquire)) {
+                slot.key = key;
+                slot.value.store(Value{}, std::memory_order_relaxed);
+                slot.state.store(FULL, std::memory_order_release);
+                return &slot;
+            }
+            //Слот перехватил другой поток - проверяем его ключ заново
+            bucket.used.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return nullptr;
+    }
+
+    static uint8_t WaitWhileBusy(const Slot& slot) {
+        uint8_t state = slot.state.load(std::memory_order_acquire);
+        while (state == BUSY) {
+            std::this_thread::yield();
+            state = slot.state.load(std::memory_order_acquire);
+        }
+        return state;
+    }
+
+    static size_t CountFull(Bucket& bucket) {
+        std::lock_guard guard(bucket.mutex);
+        return CountFullLocked(bucket);
+    }
+
+    //Перестроение сегмента в таблицу вдвое большего размера без удаленных слотов
+    static void Grow(Bucket& bucket) {
+        std::lock_guard guard(bucket.mutex);
+        if (bucket.capacity != 0 && bucket.used.load(std::memory_order_relaxed) + 1 <= bucket.capacity / 4 * 3) {
+            return; //Таблицу уже увеличил другой поток
+        }
+        const size_t full_count = CountFullLocked(bucket);
+        size_t new_capacity = MIN_CAPACITY;
+        while ((full_count + 1) * 2 > new_capacity) {
+            new_capacity *= 2;
+        }
+        std::unique_ptr<Slot[]> new_slots(new Slot[new_capacity]);
+        const size_t mask = new_capacity - 1;
+        for (size_t i = 0; i < bucket.capacity; ++i) {
+            const Slot& slot = bucket.slots[i];
+            if (slot.state.load(std::memory_order_relaxed) != FULL) {
+                continue;
+            }
+            size_t pos = Hash(slot.key) & mask;
+            while (new_slots[pos].state.load(std::memory_order_relaxed) != EMPTY) {
+                pos = (pos + 1) & mask;
+            }
+            new_slots[pos].key = slot.key;
+            new_slots[pos].value.store(slot.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            new_slots[pos].state.store(FULL, std::memory_order_relaxed);
+        }
+        bucket.slots = std::move(new_slots);
+        bucket.capacity = new_capacity;
+        bucket.used.store(full_count, std::memory_order_relaxed);
+    }
+
+    static size_t CountFullLocked(const Bucket& bucket) {
+        size_t count = 0;
+        for (size_t i = 0; i < bucket.capacity; ++i) {
+            count += bucket.slots[i].state.load(std::memory_order_relaxed) == FULL;
+        }
+        return count;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,106 @@
+#include "corpus_loader.h"
+#include "mapped_file.h"
+#include <charconv>
+#include <future>
+
+using namespace std;
+
+namespace {
+    //Разобранный пакет документов; тексты указывают в файл корпуса
+    struct CorpusBatch {
+        vector<NewDocument> documents;
+        size_t end_offset; //Начало следующей неразобранной строки
+        size_t end_line; //Ее номер
+    };
+
+    //Поле строки до табуляции; line укорачивается до следующего поля
+    string_view TakeField(string_view& line) {
+        const size_t tab = line.find('\t');
+        const string_view field = line.substr(0, tab);
+        line.remove_prefix(tab == string_view::npos ? line.size() : tab + 1);
+        return field;
+    }
+
+    bool ParseInt(string_view text, int& value) {
+        const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+        return error == errc() && end == text.data() + text.size();
+    }
+
+    bool ParseStatus(string_view text, DocumentStatus& status) {
+        static const pair<string_view, DocumentStatus> statuses[] = {
+            { "ACTUAL"sv, DocumentStatus::ACTUAL },
+            { "IRRELEVANT"sv, DocumentStatus::IRRELEVANT },
+            { "BANNED"sv, DocumentStatus::BANNED },
+            { "REMOVED"sv, DocumentStatus::REMOVED },
+        };
+        for (const auto& [name, value] : statuses) {
+            if (text == name) {
+                status = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //Строка "id<TAB>статус<TAB>рейтинги<TAB>текст"; табуляция в тексте - спецсимвол, такой документ отклонит AddDocuments
+    bool ParseRecord(string_view line, NewDocument& document) {
+        if (!ParseInt(TakeField(line), document.id) || !ParseStatus(TakeField(line), document.status)) {
+            return false;
+        }
+        string_view ratings = TakeField(line);
+        document.ratings.clear();
+        while (!ratings.empty()) {
+            const size_t space = ratings.find(' ');
+            const string_view rating = ratings.substr(0, space);
+            ratings.remove_prefix(space == string_view::npos ? ratings.size() : space + 1);
+            if (rating.empty()) {
+                continue;
+            }
+            if (!ParseInt(rating, document.ratings.emplace_back())) {
+                return false;
+            }
+        }
+        document.text = line;
+        return true;
+    }
+
+    //Разбор до batch_size документов начиная со смещения offset; пустой пакет - конец файла
+    CorpusBatch ParseBatch(string_view corpus, size_t offset, size_t line_number, size_t batch_size) {
+        CorpusBatch batch;
+        batch.documents.reserve(batch_size);
+        while (offset < corpus.size() && batch.documents.size() < batch_size) {
+            const size_t line_end = min(corpus.find('\n', offset), corpus.size());
+            string_view line = corpus.substr(offset, line_end - offset);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!line.empty() && !ParseRecord(line, batch.documents.emplace_back())) {
+                throw invalid_argument("Corpus line "s + to_string(line_number) + " is malformed"s);
+            }
+            offset = line_end + 1;
+            ++line_number;
+        }
+        batch.end_offset = offset;
+        batch.end_line = line_number;
+        return batch;
+    }
+}
+
+//Конвейер из двух стадий: поток разбора готовит следующий пакет, пока текущий индексируется.
+//Файл отображен до конца загрузки, а AddDocuments копирует тексты, если хранит их, поэтому string_view
+//на страницы файла переживают пакет
+size_t LoadCorpus(SearchServer& search_server, const string& path, const CorpusLoadOptions& options) {
+    const MappedFile file(path);
+    file.AdviseSequential();
+    const string_view corpus(reinterpret_cast<const char*>(file.data()), file.size());
+    const size_t batch_size = max<size_t>(options.batch_size, 1);
+
+    size_t loaded = 0;
+    future<CorpusBatch> next = async(launch::async, ParseBatch, corpus, 0, 1, batch_size);
+    for (CorpusBatch batch = next.get(); !batch.documents.empty(); batch = next.get()) {
+        next = async(launch::async, ParseBatch, corpus, batch.end_offset, batch.end_line, batch_size);
+        search_server.AddDocuments(execution::par, batch.documents);
+        loaded += batch.documents.size();
+    }
+    return loaded;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "search_server.h"
+#include <string>
+
+//Параметры загрузки корпуса (LoadCorpus)
+struct CorpusLoadOptions {
+    size_t batch_size = 16384; //Документов в одном вызове AddDocuments: крупные пакеты делят его накладные расходы
+};
+
+//Загрузка корпуса из файла: документ на строку, поля через табуляцию - id, статус (ACTUAL, IRRELEVANT, BANNED
+//или REMOVED), рейтинги через пробел (могут отсутствовать) и текст; пустые строки пропускаются.
+//Файл отображается в память и разбирается без копирования: тексты передаются в AddDocuments как string_view
+//на страницы файла. Загрузка идет конвейером: пока сервер индексирует пакет, отдельный поток подгружает
+//страницы и разбирает следующий. Возвращает число добавленных документов.
+//Исключения: runtime_error, если файл не открывается; invalid_argument с номером строки для неверной записи
+//и исключения AddDocuments - пакеты до ошибочного уже добавлены
+size_t LoadCorpus(SearchServer& search_server, const std::string& path, const CorpusLoadOptions& options = {});
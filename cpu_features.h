@@ -0,0 +1,23 @@
+#pragma once
+
+//Сборка под x86: SIMD-ядра компилируются всегда, выбор между ними делается во время выполнения
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_FEATURES_X86 1
+#endif
+
+//GCC и Clang компилируют AVX2-функции только с атрибутом целевой архитектуры, MSVC - без него
+#if defined(CPU_FEATURES_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_TARGET(arch) __attribute__((target(arch)))
+#else
+#define CPU_TARGET(arch)
+#endif
+
+//Наборы SIMD-инструкций, доступные процессору и ОС во время выполнения
+struct CpuFeatures {
+    bool sse2 = false;
+    bool sse42 = false; //В том числе инструкция crc32
+    bool avx2 = false;
+};
+
+//Определяется один раз при первом вызове
+const CpuFeatures& GetCpuFeatures();
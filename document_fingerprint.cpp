@@ -0,0 +1,40 @@
+#include "document_fingerprint.h"
+#include <cstring>
+
+using namespace std;
+
+namespace {
+    //Финальное перемешивание splitmix64
+    uint64_t Mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    //Хеш байтов по 8 за шаг; разные seed дают независимые половины отпечатка
+    uint64_t HashBytes(string_view bytes, uint64_t seed) {
+        uint64_t hash = Mix(seed ^ (bytes.size() * 0x9E3779B97F4A7C15ULL));
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= bytes.size(); i += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, bytes.data() + i, sizeof(word));
+            hash = Mix(hash ^ word) + seed;
+        }
+        uint64_t tail = 0;
+        if (i < bytes.size()) {
+            memcpy(&tail, bytes.data() + i, bytes.size() - i);
+        }
+        return Mix(hash ^ tail);
+    }
+}
+
+//Отпечаток слова: две независимые 64-битные хеш-функции от его байтов
+DocumentFingerprint ComputeTermFingerprint(string_view term) {
+    return {
+        HashBytes(term, 0x243F6A8885A308D3ULL),
+        HashBytes(term, 0x13198A2E03707344ULL)
+    };
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+//128-битный отпечаток множества слов документа - сумма отпечатков его различных слов.
+//Сумма не зависит от порядка слов и пересчитывается прибавлением отпечатка слова без перебора остальных
+struct DocumentFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    DocumentFingerprint& operator+=(const DocumentFingerprint& other) {
+        low += other.low;
+        high += other.high;
+        return *this;
+    }
+};
+
+inline bool operator==(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs) {
+    return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+
+inline bool operator!=(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs) {
+    return !(lhs == rhs);
+}
+
+struct DocumentFingerprintHasher {
+    size_t operator()(const DocumentFingerprint& fingerprint) const {
+        return static_cast<size_t>(fingerprint.low ^ (fingerprint.high * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+//Отпечаток слова: две независимые 64-битные хеш-функции от его байтов
+DocumentFingerprint ComputeTermFingerprint(std::string_view term);
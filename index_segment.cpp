@@ -0,0 +1,122 @@
+#include "index_segment.h"
+#include "snapshot_io.h"
+#include <numeric>
+
+using namespace std;
+
+//Список словопозиций слова для дописывания; создается при первом обращении. Только для открытого сегмента
+PostingList& IndexSegment::AddTerm(TermId term_id) {
+    const auto [it, inserted] = positions_.emplace(term_id, static_cast<uint32_t>(term_ids_.size()));
+    if (inserted) {
+        term_ids_.push_back(term_id);
+        postings_.emplace_back();
+    }
+    return postings_[it->second];
+}
+
+//Заморозка: слова сортируются, хеш-таблица освобождается, списки ужимаются
+void IndexSegment::Freeze() {
+    vector<uint32_t> order(term_ids_.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return term_ids_[lhs] < term_ids_[rhs];
+        });
+    vector<TermId> term_ids;
+    vector<PostingList> postings;
+    term_ids.reserve(order.size());
+    postings.reserve(order.size());
+    posting_count_ = 0;
+    for (const uint32_t position : order) {
+        term_ids.push_back(term_ids_[position]);
+        postings.push_back(move(postings_[position]));
+        postings.back().ShrinkToFit();
+        posting_count_ += postings.back().size();
+    }
+    term_ids_ = move(term_ids);
+    postings_ = move(postings);
+    unordered_map<TermId, uint32_t>().swap(positions_);
+    frozen_ = true;
+}
+
+//Список словопозиций слова; nullptr, если слова в сегменте нет
+const PostingList* IndexSegment::Find(TermId term_id) const {
+    if (!frozen_) {
+        const auto it = positions_.find(term_id);
+        return it == positions_.end() ? nullptr : &postings_[it->second];
+    }
+    const auto it = lower_bound(term_ids_.begin(), term_ids_.end(), term_id);
+    return it == term_ids_.end() || *it != term_id ? nullptr : &postings_[it - term_ids_.begin()];
+}
+
+//Число словопозиций, включая словопозиции удаленных документов
+size_t IndexSegment::GetPostingCount() const {
+    if (frozen_) {
+        return posting_count_;
+    }
+    size_t posting_count = 0;
+    for (const PostingList& postings : postings_) {
+        posting_count += postings.size();
+    }
+    return posting_count;
+}
+
+//Удаление слов, все словопозиции которых убраны
+void IndexSegment::EraseEmptyTerms() {
+    size_t kept = 0;
+    for (size_t i = 0; i < term_ids_.size(); ++i) {
+        if (postings_[i].empty()) {
+            continue;
+        }
+        if (kept != i) {
+            term_ids_[kept] = term_ids_[i];
+            postings_[kept] = move(postings_[i]);
+        }
+        ++kept;
+    }
+    term_ids_.resize(kept);
+    postings_.resize(kept);
+}
+
+//Запись сегмента в снимок; слова открытого сегмента записываются по возрастанию, как у замороженного
+void IndexSegment::Save(SnapshotWriter& writer) const {
+    vector<uint32_t> order(term_ids_.size());
+    iota(order.begin(), order.end(), 0);
+    if (!frozen_) {
+        sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs) {
+            return term_ids_[lhs] < term_ids_[rhs];
+            });
+    }
+    vector<TermId> term_ids;
+    term_ids.reserve(order.size());
+    for (const uint32_t position : order) {
+        term_ids.push_back(term_ids_[position]);
+    }
+    writer.Write(first_ordinal_);
+    writer.Write(end_ordinal_);
+    writer.Write<uint64_t>(term_ids.size());
+    writer.WriteArray(term_ids.data(), term_ids.size());
+    for (const uint32_t position : order) {
+        postings_[position].Save(writer);
+    }
+}
+
+//Замороженный сегмент поверх данных снимка: списки словопозиций читаются из памяти снимка без копирования
+IndexSegment IndexSegment::Map(SnapshotReader& reader, size_t term_count) {
+    IndexSegment segment(reader.Read<DocumentOrdinal>());
+    segment.end_ordinal_ = reader.Read<DocumentOrdinal>();
+    CheckSnapshot(segment.first_ordinal_ <= segment.end_ordinal_);
+    const auto segment_term_count = reader.Read<uint64_t>();
+    CheckSnapshot(segment_term_count <= term_count);
+    const TermId* term_ids = reader.ReadArray<TermId>(segment_term_count);
+    for (size_t i = 0; i < segment_term_count; ++i) {
+        CheckSnapshot(term_ids[i] < term_count && (i == 0 || term_ids[i - 1] < term_ids[i]));
+    }
+    segment.term_ids_.assign(term_ids, term_ids + segment_term_count);
+    segment.postings_.reserve(segment_term_count);
+    segment.frozen_ = true;
+    for (size_t i = 0; i < segment_term_count; ++i) {
+        segment.postings_.push_back(PostingList::Map(reader, segment.first_ordinal_, segment.end_ordinal_));
+        segment.posting_count_ += segment.postings_.back().size();
+    }
+    return segment;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "posting_list.h"
+#include "term_dictionary.h"
+#include <algorithm>
+#include <execution>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+//Сегмент индекса: списки словопозиций документов с номерами из [first_ordinal, end_ordinal).
+//Открытый сегмент принимает новые словопозиции и ищет слова по хеш-таблице. Замороженный сегмент больше
+//не меняется: слова в нем отсортированы и ищутся бинарным поиском, списки ужаты до размера данных,
+//поэтому запросы и слияния читают его без копирования
+class IndexSegment {
+public:
+    explicit IndexSegment(DocumentOrdinal first_ordinal = 0)
+        : first_ordinal_(first_ordinal)
+        , end_ordinal_(first_ordinal) {
+    }
+
+    //Список словопозиций слова для дописывания; создается при первом обращении. Только для открытого сегмента
+    PostingList& AddTerm(TermId term_id);
+
+    //Список уже добавленного слова для дописывания. Сегмент не меняется, поэтому списки разных слов
+    //можно дописывать из нескольких потоков
+    PostingList& GetPostings(TermId term_id) {
+        return postings_[positions_.at(term_id)];
+    }
+
+    //Расширение диапазона номеров до end_ordinal (документы без слов не попадают в списки)
+    void SetEndOrdinal(DocumentOrdinal end_ordinal) {
+        end_ordinal_ = end_ordinal;
+    }
+
+    //Заморозка: слова сортируются, хеш-таблица освобождается, списки ужимаются
+    void Freeze();
+
+    //Список словопозиций слова; nullptr, если слова в сегменте нет
+    const PostingList* Find(TermId term_id) const;
+
+    DocumentOrdinal GetFirstOrdinal() const {
+        return first_ordinal_;
+    }
+
+    DocumentOrdinal GetEndOrdinal() const {
+        return end_ordinal_;
+    }
+
+    bool IsFrozen() const {
+        return frozen_;
+    }
+
+    //Число словопозиций, включая словопозиции удаленных документов
+    size_t GetPostingCount() const;
+
+    //Запись сегмента в снимок; слова открытого сегмента записываются по возрастанию, как у замороженного
+    void Save(SnapshotWriter& writer) const;
+
+    //Замороженный сегмент поверх данных снимка: списки словопозиций читаются из памяти снимка без копирования.
+    //Проверяется, что слова идут по возрастанию и меньше term_count
+    static IndexSegment Map(SnapshotReader& reader, size_t term_count);
+
+    //Номер, которым функция перенумерации в Renumber отмечает удаленный документ
+    static constexpr DocumentOrdinal REMOVED_ORDINAL = std::numeric_limits<DocumentOrdinal>::max();
+
+    //Слияние соседних сегментов (по возрастанию номеров) в один замороженный без словопозиций,
+    //для которых is_removed(ordinal) истинно. Исходные сегменты не меняются; списки слов строятся параллельно
+    template <typename ExecutionPolicy, typename Predicate>
+    static IndexSegment Merge(ExecutionPolicy&& policy, const std::vector<const IndexSegment*>& segments, Predicate is_removed) {
+        return Renumber(policy, segments, segments.front()->first_ordinal_, segments.back()->end_ordinal_,
+            [&is_removed](DocumentOrdinal ordinal) {
+                return is_removed(ordinal) ? REMOVED_ORDINAL : ordinal;
+            });
+    }
+
+    //Слияние соседних сегментов в один замороженный сегмент [first_ordinal, end_ordinal) с новыми номерами:
+    //словопозиция документа ordinal получает номер new_ordinal(ordinal), словопозиции с REMOVED_ORDINAL
+    //отбрасываются. Новые номера должны возрастать вместе со старыми
+    template <typename ExecutionPolicy, typename NewOrdinal>
+    static IndexSegment Renumber(ExecutionPolicy&& policy, const std::vector<const IndexSegment*>& segments,
+        DocumentOrdinal first_ordinal, DocumentOrdinal end_ordinal, NewOrdinal new_ordinal) {
+        IndexSegment merged(first_ordinal);
+        merged.end_ordinal_ = end_ordinal;
+        for (const IndexSegment* segment : segments) {
+            merged.term_ids_.insert(merged.term_ids_.end(), segment->term_ids_.begin(), segment->term_ids_.end());
+        }
+        std::sort(merged.term_ids_.begin(), merged.term_ids_.end());
+        merged.term_ids_.erase(std::unique(merged.term_ids_.begin(), merged.term_ids_.end()), merged.term_ids_.end());
+
+        //Сегменты обходятся по порядку, поэтому номера документов в новом списке возрастают
+        merged.postings_.resize(merged.term_ids_.size());
+        std::transform(policy, merged.term_ids_.begin(), merged.term_ids_.end(), merged.postings_.begin(), [&](TermId term_id) {
+            PostingList kept;
+            for (const IndexSegment* segment : segments) {
+                if (const PostingList* postings = segment->Find(term_id)) {
+                    postings->ForEach([&](DocumentOrdinal ordinal, uint32_t count) {
+                        const DocumentOrdinal kept_ordinal = new_ordinal(ordinal);
+                        if (kept_ordinal != REMOVED_ORDINAL) {
+                            kept.Append(kept_ordinal, count);
+                        }
+                        });
+                }
+            }
+            return kept;
+            });
+        merged.EraseEmptyTerms();
+        merged.Freeze();
+        return merged;
+    }
+
+private:
+    DocumentOrdinal first_ordinal_;
+    DocumentOrdinal end_ordinal_;
+    bool frozen_ = false;
+    std::vector<TermId> term_ids_; //В замороженном сегменте - по возрастанию
+    std::vector<PostingList> postings_; //Списки слов term_ids_ в том же порядке
+    std::unordered_map<TermId, uint32_t> positions_; //"TermId" - "Позиция в term_ids_"; только в открытом сегменте
+    size_t posting_count_ = 0; //Подсчитывается при заморозке
+
+    //Удаление слов, все словопозиции которых убраны
+    void EraseEmptyTerms();
+};
@@ -65,9 +65,12 @@ int main() {
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
 
     SearchServer search_server(dictionary[0]);
+    vector<NewDocument> new_documents;
+    new_documents.reserve(documents.size());
     for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        new_documents.push_back({ static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 } });
     }
+    search_server.AddDocuments(new_documents);
 
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
 
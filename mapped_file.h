@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//Файл, отображенный в память только для чтения (mmap в POSIX, MapViewOfFile в Windows).
+//Страницы подгружаются по первому обращению и разделяются процессами, отобразившими тот же файл
+class MappedFile {
+public:
+    //Отображение файла целиком; runtime_error, если файл не открывается или не отображается
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    //Подсказка ОС для прохода по файлу от начала к концу: страницы читаются вперед большими порциями
+    void AdviseSequential() const;
+
+private:
+    const uint8_t* data_ = nullptr; //nullptr для пустого файла
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
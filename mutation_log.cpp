@@ -0,0 +1,397 @@
+#include "mutation_log.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <array>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+    constexpr uint64_t MUTATION_LOG_MAGIC = 0x31474F4C4E54554DULL; //Байты "MUTNLOG1" в начале файла
+    //Заголовок записи: размер тела (u32), CRC32C (u32), номер (u64), тип (u8).
+    //Контрольная сумма считается по телу, затем по номеру и типу: сумму тела можно посчитать до выдачи номера
+    constexpr size_t RECORD_HEADER_SIZE = 4 + 4 + 8 + 1;
+
+    constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78; //Полином Кастаньоли в обратном порядке битов
+
+    array<uint32_t, 256> MakeCrc32cTable() {
+        array<uint32_t, 256> table{};
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (crc & 1u)));
+            }
+            table[byte] = crc;
+        }
+        return table;
+    }
+
+    uint32_t UpdateCrc32cScalar(uint32_t crc, const uint8_t* data, size_t size) {
+        static const array<uint32_t, 256> table = MakeCrc32cTable();
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+#ifdef CPU_FEATURES_X86
+    //Инструкция crc32 считает ту же сумму по 8 (в 32-битной сборке по 4) байт за шаг
+    CPU_TARGET("sse4.2")
+    uint32_t UpdateCrc32cSse42(uint32_t crc, const uint8_t* data, size_t size) {
+        size_t i = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+        uint64_t crc64 = crc;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+        }
+        crc = static_cast<uint32_t>(crc64);
+#else
+        for (; i + 4 <= size; i += 4) {
+            uint32_t word;
+            memcpy(&word, data + i, sizeof(word));
+            crc = _mm_crc32_u32(crc, word);
+        }
+#endif
+        for (; i < size; ++i) {
+            crc = _mm_crc32_u8(crc, data[i]);
+        }
+        return crc;
+    }
+#endif
+
+    using Crc32cKernel = uint32_t(*)(uint32_t, const uint8_t*, size_t);
+
+    Crc32cKernel SelectCrc32cKernel() {
+#ifdef CPU_FEATURES_X86
+        if (GetCpuFeatures().sse42) {
+            return UpdateCrc32cSse42;
+        }
+#endif
+        return UpdateCrc32cScalar;
+    }
+
+    //Сумма записи из суммы тела: продолжение по номеру и типу
+    uint32_t ComputeRecordCrc(uint32_t body_crc, uint64_t lsn, MutationType type) {
+        uint8_t tail[sizeof(lsn) + 1];
+        memcpy(tail, &lsn, sizeof(lsn));
+        tail[sizeof(lsn)] = static_cast<uint8_t>(type);
+        return ComputeCrc32c(tail, sizeof(tail), body_crc);
+    }
+
+    bool IsKnownType(uint8_t type) {
+        return type >= static_cast<uint8_t>(MutationType::ADD_DOCUMENTS) && type <= static_cast<uint8_t>(MutationType::SET_TEXT_STORAGE);
+    }
+
+    template <typename T>
+    void AppendValue(vector<uint8_t>& out, const T& value) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+#ifdef _WIN32
+    using FileHandle = void*;
+
+    FileHandle OpenLogFile(const string& path) {
+        const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw runtime_error("Cannot open file "s + path);
+        }
+        return file;
+    }
+
+    void CloseLogFile(FileHandle file) {
+        CloseHandle(file);
+    }
+
+    bool ReadLogFile(FileHandle file, vector<uint8_t>& contents) {
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) {
+            return false;
+        }
+        contents.resize(static_cast<size_t>(file_size.QuadPart));
+        size_t offset = 0;
+        while (offset < contents.size()) {
+            DWORD read = 0;
+            const auto chunk = static_cast<DWORD>(min<size_t>(contents.size() - offset, 1u << 30));
+            if (!ReadFile(file, contents.data() + offset, chunk, &read, nullptr) || read == 0) {
+                return false;
+            }
+            offset += read;
+        }
+        return true;
+    }
+
+    bool AppendToLogFile(FileHandle file, const uint8_t* data, size_t size) {
+        LARGE_INTEGER zero{};
+        if (!SetFilePointerEx(file, zero, nullptr, FILE_END)) {
+            return false;
+        }
+        while (size != 0) {
+            DWORD written = 0;
+            const auto chunk = static_cast<DWORD>(min<size_t>(size, 1u << 30));
+            if (!WriteFile(file, data, chunk, &written, nullptr)) {
+                return false;
+            }
+            data += written;
+            size -= written;
+        }
+        return FlushFileBuffers(file) != 0;
+    }
+
+    bool TruncateLogFile(FileHandle file, uint64_t size) {
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(size);
+        return SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && SetEndOfFile(file) && FlushFileBuffers(file);
+    }
+#else
+    using FileHandle = int;
+
+    FileHandle OpenLogFile(const string& path) {
+        const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            throw runtime_error("Cannot open file "s + path);
+        }
+        return fd;
+    }
+
+    void CloseLogFile(FileHandle file) {
+        close(file);
+    }
+
+    //Сброс данных файла на диск; метаданные, не нужные для чтения (время изменения), не ждем
+    bool SyncLogFile(FileHandle file) {
+#ifdef __linux__
+        return fdatasync(file) == 0;
+#else
+        return fsync(file) == 0;
+#endif
+    }
+
+    bool ReadLogFile(FileHandle file, vector<uint8_t>& contents) {
+        struct stat file_stat;
+        if (fstat(file, &file_stat) != 0) {
+            return false;
+        }
+        contents.resize(static_cast<size_t>(file_stat.st_size));
+        size_t offset = 0;
+        while (offset < contents.size()) {
+            const ssize_t read = pread(file, contents.data() + offset, contents.size() - offset, static_cast<off_t>(offset));
+            if (read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (read <= 0) {
+                return false;
+            }
+            offset += static_cast<size_t>(read);
+        }
+        return true;
+    }
+
+    bool AppendToLogFile(FileHandle file, const uint8_t* data, size_t size) {
+        if (lseek(file, 0, SEEK_END) < 0) {
+            return false;
+        }
+        while (size != 0) {
+            const ssize_t written = write(file, data, size);
+            //Прерывание сигналом до записи первого байта - не ошибка, запись повторяется
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return SyncLogFile(file);
+    }
+
+    bool TruncateLogFile(FileHandle file, uint64_t size) {
+        return ftruncate(file, static_cast<off_t>(size)) == 0 && SyncLogFile(file);
+    }
+#endif
+}
+
+//Контрольная сумма CRC32C с продолжением от crc
+uint32_t ComputeCrc32c(const void* data, size_t size, uint32_t crc) {
+    static const Crc32cKernel kernel = SelectCrc32cKernel();
+    return ~kernel(~crc, static_cast<const uint8_t*>(data), size);
+}
+
+//Открытие журнала: целые записи читаются подряд до первой оборванной, испорченной или идущей не по порядку,
+//с нее файл усекается
+MutationLog::MutationLog(const string& path)
+    : path_(path)
+    , file_(OpenLogFile(path)) {
+    try {
+        if (!ReadLogFile(file_, contents_)) {
+            throw runtime_error("Cannot read file "s + path_);
+        }
+        const auto magic = MUTATION_LOG_MAGIC;
+        const size_t magic_size = min(contents_.size(), sizeof(magic));
+        if (magic_size != 0 && memcmp(contents_.data(), &magic, magic_size) != 0) {
+            throw runtime_error("File is not a mutation log: "s + path_);
+        }
+        if (contents_.size() < sizeof(magic)) {
+            //Новый журнал или сбой во время его создания
+            vector<uint8_t> header;
+            AppendValue(header, magic);
+            if (!TruncateLogFile(file_, 0) || !WriteDurable(header)) {
+                throw runtime_error("Cannot write file "s + path_);
+            }
+            contents_.clear();
+            return;
+        }
+
+        size_t offset = sizeof(magic);
+        uint64_t last_lsn = 0;
+        while (contents_.size() - offset >= RECORD_HEADER_SIZE) {
+            const uint8_t* header = contents_.data() + offset;
+            uint32_t body_size;
+            uint32_t crc;
+            uint64_t lsn;
+            memcpy(&body_size, header, 4);
+            memcpy(&crc, header + 4, 4);
+            memcpy(&lsn, header + 8, 8);
+            const uint8_t type = header[16];
+            if (body_size > contents_.size() - offset - RECORD_HEADER_SIZE || lsn <= last_lsn || !IsKnownType(type)) {
+                break;
+            }
+            const uint8_t* body = header + RECORD_HEADER_SIZE;
+            const auto mutation_type = static_cast<MutationType>(type);
+            if (ComputeRecordCrc(ComputeCrc32c(body, body_size), lsn, mutation_type) != crc) {
+                break;
+            }
+            records_.push_back({ lsn, mutation_type, { reinterpret_cast<const char*>(body), body_size } });
+            last_lsn = lsn;
+            offset += RECORD_HEADER_SIZE + body_size;
+        }
+        if (offset < contents_.size() && !TruncateLogFile(file_, offset)) {
+            throw runtime_error("Cannot truncate file "s + path_);
+        }
+        next_lsn_ = last_lsn + 1;
+        pending_lsn_ = durable_lsn_ = last_lsn;
+    }
+    catch (...) {
+        CloseLogFile(file_);
+        throw;
+    }
+}
+
+//Записи, добавленные без ожидания, дописываются при закрытии
+MutationLog::~MutationLog() {
+    if (!failed_ && !pending_.empty()) {
+        WriteDurable(pending_);
+    }
+    CloseLogFile(file_);
+}
+
+void MutationLog::ReleaseRecords() {
+    records_ = {};
+    contents_ = {};
+}
+
+//Номера следующих записей будут больше lsn
+void MutationLog::SkipTo(uint64_t lsn) {
+    lock_guard lock(mutex_);
+    if (lsn >= next_lsn_) {
+        next_lsn_ = lsn + 1;
+        if (pending_.empty()) {
+            pending_lsn_ = durable_lsn_ = lsn;
+        }
+    }
+}
+
+//Добавление записи в буфер группы. Сумма тела считается до блокировки, под ней только дописываются байты
+uint64_t MutationLog::Append(MutationType type, const vector<uint8_t>& body) {
+    const uint32_t body_crc = ComputeCrc32c(body.data(), body.size());
+    lock_guard lock(mutex_);
+    if (failed_) {
+        throw runtime_error("Mutation log is unavailable after a write error: "s + path_);
+    }
+    const uint64_t lsn = next_lsn_++;
+    AppendValue(pending_, static_cast<uint32_t>(body.size()));
+    AppendValue(pending_, ComputeRecordCrc(body_crc, lsn, type));
+    AppendValue(pending_, lsn);
+    pending_.push_back(static_cast<uint8_t>(type));
+    pending_.insert(pending_.end(), body.begin(), body.end());
+    pending_lsn_ = lsn;
+    return lsn;
+}
+
+//Групповая фиксация: поток, заставший журнал без записи, забирает всю накопленную группу и пишет ее
+//без блокировки; потоки, чьи записи попали в группу, дожидаются ее, остальные - следующей группы
+void MutationLog::WaitDurable(uint64_t lsn) {
+    unique_lock lock(mutex_);
+    while (durable_lsn_ < lsn) {
+        if (failed_) {
+            throw runtime_error("Mutation log is unavailable after a write error: "s + path_);
+        }
+        if (flushing_) {
+            flushed_.wait(lock);
+            continue;
+        }
+        flushing_ = true;
+        vector<uint8_t> group;
+        group.swap(pending_);
+        const uint64_t group_lsn = pending_lsn_;
+        lock.unlock();
+        const bool written = WriteDurable(group);
+        lock.lock();
+        flushing_ = false;
+        if (written) {
+            durable_lsn_ = group_lsn;
+        }
+        else {
+            failed_ = true;
+        }
+        //Буфер группы возвращается, чтобы следующие группы не выделяли память заново
+        if (pending_.empty()) {
+            group.clear();
+            pending_.swap(group);
+        }
+        flushed_.notify_all();
+    }
+}
+
+//Удаление всех записей: файл усекается до заголовка, ожидающие записи считаются сохраненными
+void MutationLog::Clear() {
+    unique_lock lock(mutex_);
+    flushed_.wait(lock, [this] {
+        return !flushing_;
+        });
+    if (failed_) {
+        throw runtime_error("Mutation log is unavailable after a write error: "s + path_);
+    }
+    pending_.clear();
+    Truncate(sizeof(MUTATION_LOG_MAGIC));
+    pending_lsn_ = durable_lsn_ = next_lsn_ - 1;
+    flushed_.notify_all();
+}
+
+bool MutationLog::WriteDurable(const vector<uint8_t>& bytes) {
+    return AppendToLogFile(file_, bytes.data(), bytes.size());
+}
+
+void MutationLog::Truncate(uint64_t size) {
+    if (!TruncateLogFile(file_, size)) {
+        failed_ = true;
+        throw runtime_error("Cannot truncate file "s + path_);
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+//Тип записи журнала изменений
+enum class MutationType : uint8_t {
+    ADD_DOCUMENTS = 1,
+    REMOVE_DOCUMENTS = 2,
+    SET_TEXT_STORAGE = 3,
+};
+
+//Запись журнала, прочитанная при открытии; body указывает в буфер журнала
+struct MutationRecord {
+    uint64_t lsn;
+    MutationType type;
+    std::string_view body;
+};
+
+//Тело записи журнала: значения подряд в порядке байтов процессора, строки - длина и символы
+class MutationEncoder {
+public:
+    template <typename T>
+    void Put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "Mutation log stores only trivially copyable values");
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        bytes_.insert(bytes_.end(), bytes, bytes + sizeof(T));
+    }
+
+    void PutString(std::string_view text) {
+        Put<uint32_t>(static_cast<uint32_t>(text.size()));
+        bytes_.insert(bytes_.end(), text.begin(), text.end());
+    }
+
+    const std::vector<uint8_t>& GetBytes() const {
+        return bytes_;
+    }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+//Чтение тела записи; runtime_error, если данные кончаются раньше времени. Строки указывают в тело записи
+class MutationDecoder {
+public:
+    explicit MutationDecoder(std::string_view body)
+        : body_(body) {
+    }
+
+    template <typename T>
+    T Get() {
+        static_assert(std::is_trivially_copyable_v<T>, "Mutation log stores only trivially copyable values");
+        T value;
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string_view GetString() {
+        const auto size = Get<uint32_t>();
+        return { Take(size), size };
+    }
+
+    bool AtEnd() const {
+        return offset_ == body_.size();
+    }
+
+private:
+    std::string_view body_;
+    size_t offset_ = 0;
+
+    const char* Take(size_t size) {
+        if (size > body_.size() - offset_) {
+            throw std::runtime_error("Mutation log record is corrupted");
+        }
+        const char* data = body_.data() + offset_;
+        offset_ += size;
+        return data;
+    }
+};
+
+//Журнал изменений - файл, в конец которого дописываются записи: размер, контрольная сумма CRC32C, номер (LSN),
+//тип и тело. Номера записей возрастают. Групповая фиксация: Append только копирует запись в буфер,
+//первый поток, вызвавший WaitDurable, пишет в файл и сбрасывает на диск все накопленные записи одним fsync,
+//остальные ждут его; записи, добавленные во время сброса, уходят следующей группой.
+//После ошибки записи журнал отказывает во всех операциях (runtime_error)
+class MutationLog {
+public:
+    //Открытие журнала; файл создается, если его нет. Целые записи читаются в память для воспроизведения,
+    //оборванный или испорченный конец файла (запись, прерванная сбоем) отрезается
+    explicit MutationLog(const std::string& path);
+    ~MutationLog();
+
+    MutationLog(const MutationLog&) = delete;
+    MutationLog& operator=(const MutationLog&) = delete;
+
+    //Записи, прочитанные при открытии, по возрастанию номеров
+    const std::vector<MutationRecord>& GetRecords() const {
+        return records_;
+    }
+
+    //Освобождение прочитанных записей после воспроизведения
+    void ReleaseRecords();
+
+    //Номера следующих записей будут больше lsn (после загрузки снимка, который новее журнала)
+    void SkipTo(uint64_t lsn);
+
+    //Добавление записи в буфер группы; возвращает номер записи
+    uint64_t Append(MutationType type, const std::vector<uint8_t>& body);
+
+    //Ожидание, пока записи с номерами до lsn включительно не окажутся на диске
+    void WaitDurable(uint64_t lsn);
+
+    //Удаление всех записей, когда они вошли в сохраненный снимок; нумерация продолжается
+    void Clear();
+
+private:
+    std::string path_;
+#ifdef _WIN32
+    void* file_ = nullptr;
+#else
+    int file_ = -1;
+#endif
+    std::vector<uint8_t> contents_; //Прочитанный при открытии файл; в нем лежат тела records_
+    std::vector<MutationRecord> records_;
+
+    std::mutex mutex_;
+    std::condition_variable flushed_;
+    std::vector<uint8_t> pending_; //Записи группы, еще не переданные в файл
+    uint64_t next_lsn_ = 1;
+    uint64_t pending_lsn_ = 0; //Номер последней записи в pending_
+    uint64_t durable_lsn_ = 0;
+    bool flushing_ = false; //Какой-то поток пишет группу в файл
+    bool failed_ = false;
+
+    //Запись байтов в конец файла и сброс на диск; false при ошибке. Вызывается без mutex_
+    bool WriteDurable(const std::vector<uint8_t>& bytes);
+
+    //Усечение файла до size байт с сбросом на диск
+    void Truncate(uint64_t size);
+};
+
+//Контрольная сумма CRC32C (полином Кастаньоли) с продолжением от crc; инструкция crc32 SSE4.2, если доступна
+uint32_t ComputeCrc32c(const void* data, size_t size, uint32_t crc = 0);
@@ -0,0 +1,169 @@
+#include "near_duplicates.h"
+#include "document_fingerprint.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace {
+    //Документ для сравнения: отсортированные хеши его слов и MinHash-сигнатура
+    struct DocumentSketch {
+        vector<uint64_t> term_hashes;
+        vector<uint64_t> signature;
+    };
+
+    //Число строк в полосе: наибольшее, при котором пара с порогом сходства становится кандидатом
+    //с вероятностью не ниже 0.999; лишние кандидаты отсекает точная проверка
+    size_t ChooseRowsPerBand(double threshold, size_t signature_size) {
+        size_t best_rows = 1;
+        for (size_t rows = 1; rows <= signature_size; ++rows) {
+            const size_t bands = signature_size / rows;
+            const double candidate_probability = 1.0 - pow(1.0 - pow(threshold, static_cast<double>(rows)), static_cast<double>(bands));
+            if (candidate_probability >= 0.999) {
+                best_rows = rows;
+            }
+        }
+        return best_rows;
+    }
+
+    DocumentSketch BuildSketch(const SearchServer& search_server, int document_id, size_t signature_size) {
+        DocumentSketch sketch;
+        sketch.signature.assign(signature_size, numeric_limits<uint64_t>::max());
+        for (const auto& [word, term_freq] : search_server.GetWordFrequencies(document_id)) {
+            const DocumentFingerprint fingerprint = ComputeTermFingerprint(word);
+            sketch.term_hashes.push_back(fingerprint.low);
+            //Семейство хеш-функций h1 + i * h2 из двух независимых половин отпечатка слова
+            const uint64_t step = fingerprint.high | 1;
+            uint64_t hash = fingerprint.low;
+            for (size_t i = 0; i < signature_size; ++i, hash += step) {
+                sketch.signature[i] = min(sketch.signature[i], hash);
+            }
+        }
+        sort(sketch.term_hashes.begin(), sketch.term_hashes.end());
+        return sketch;
+    }
+
+    //Точный коэффициент Жаккара по отсортированным хешам слов
+    double ComputeJaccard(const vector<uint64_t>& lhs, const vector<uint64_t>& rhs) {
+        size_t common = 0;
+        for (auto left = lhs.begin(), right = rhs.begin(); left != lhs.end() && right != rhs.end();) {
+            if (*left < *right) {
+                ++left;
+            }
+            else if (*right < *left) {
+                ++right;
+            }
+            else {
+                ++common;
+                ++left;
+                ++right;
+            }
+        }
+        return static_cast<double>(common) / static_cast<double>(lhs.size() + rhs.size() - common);
+    }
+
+    size_t FindRoot(vector<size_t>& parents, size_t index) {
+        while (parents[index] != index) {
+            parents[index] = parents[parents[index]];
+            index = parents[index];
+        }
+        return index;
+    }
+
+    template <typename ExecutionPolicy>
+    vector<vector<int>> FindNearDuplicatesImpl(ExecutionPolicy&& policy, const SearchServer& search_server, const NearDuplicateOptions& options) {
+        if (options.similarity_threshold <= 0.0 || options.similarity_threshold > 1.0 || options.signature_size == 0) {
+            throw invalid_argument("Similarity threshold must be in (0, 1] and signature must not be empty"s);
+        }
+        const vector<int> document_ids(search_server.begin(), search_server.end());
+        vector<DocumentSketch> sketches(document_ids.size());
+        transform(policy, document_ids.begin(), document_ids.end(), sketches.begin(), [&](int document_id) {
+            return BuildSketch(search_server, document_id, options.signature_size);
+            });
+
+        //Каждая полоса сигнатуры обрабатывается отдельно: документы с одинаковым хешем полосы - кандидаты.
+        //В группе берутся пары с первым и с предыдущим документом, чтобы большие группы не давали квадрат пар;
+        //кластеры все равно собираются по цепочкам пар
+        const size_t rows = ChooseRowsPerBand(options.similarity_threshold, options.signature_size);
+        vector<vector<pair<size_t, size_t>>> band_candidates(options.signature_size / rows);
+        for_each(policy, band_candidates.begin(), band_candidates.end(), [&](vector<pair<size_t, size_t>>& candidates) {
+            const size_t first_row = (&candidates - band_candidates.data()) * rows;
+            vector<pair<uint64_t, size_t>> band_hashes;
+            band_hashes.reserve(sketches.size());
+            for (size_t i = 0; i < sketches.size(); ++i) {
+                if (sketches[i].term_hashes.empty()) {
+                    continue;
+                }
+                const string_view band(reinterpret_cast<const char*>(sketches[i].signature.data() + first_row), rows * sizeof(uint64_t));
+                band_hashes.push_back({ ComputeTermFingerprint(band).low, i });
+            }
+            sort(band_hashes.begin(), band_hashes.end());
+            for (size_t group = 0; group < band_hashes.size();) {
+                size_t next = group + 1;
+                for (; next < band_hashes.size() && band_hashes[next].first == band_hashes[group].first; ++next) {
+                    candidates.push_back({ band_hashes[group].second, band_hashes[next].second });
+                    if (next - 1 != group) {
+                        candidates.push_back({ band_hashes[next - 1].second, band_hashes[next].second });
+                    }
+                }
+                group = next;
+            }
+            });
+
+        vector<pair<size_t, size_t>> candidates;
+        for (const auto& band : band_candidates) {
+            candidates.insert(candidates.end(), band.begin(), band.end());
+        }
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+        vector<char> is_similar(candidates.size());
+        transform(policy, candidates.begin(), candidates.end(), is_similar.begin(), [&](const pair<size_t, size_t>& candidate) {
+            return ComputeJaccard(sketches[candidate.first].term_hashes, sketches[candidate.second].term_hashes) >= options.similarity_threshold;
+            });
+
+        //Объединение подтвержденных пар в кластеры
+        vector<size_t> parents(document_ids.size());
+        iota(parents.begin(), parents.end(), 0);
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (is_similar[i]) {
+                const size_t left = FindRoot(parents, candidates[i].first);
+                const size_t right = FindRoot(parents, candidates[i].second);
+                parents[max(left, right)] = min(left, right);
+            }
+        }
+        //Корень - документ с наименьшим id кластера, он становится первым в кластере
+        vector<vector<int>> clusters;
+        vector<size_t> cluster_of_root(document_ids.size(), numeric_limits<size_t>::max());
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const size_t root = FindRoot(parents, i);
+            if (root == i) {
+                continue;
+            }
+            if (cluster_of_root[root] == numeric_limits<size_t>::max()) {
+                cluster_of_root[root] = clusters.size();
+                clusters.push_back({ document_ids[root] });
+            }
+            clusters[cluster_of_root[root]].push_back(document_ids[i]);
+        }
+        sort(clusters.begin(), clusters.end());
+        return clusters;
+    }
+}
+
+vector<vector<int>> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options) {
+    return FindNearDuplicates(execution::par, search_server, options);
+}
+
+vector<vector<int>> FindNearDuplicates(const execution::sequenced_policy&, const SearchServer& search_server, const NearDuplicateOptions& options) {
+    return FindNearDuplicatesImpl(execution::seq, search_server, options);
+}
+
+vector<vector<int>> FindNearDuplicates(const execution::parallel_policy&, const SearchServer& search_server, const NearDuplicateOptions& options) {
+    return FindNearDuplicatesImpl(execution::par, search_server, options);
+}
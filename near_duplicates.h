@@ -0,0 +1,21 @@
+#pragma once
+#include "search_server.h"
+#include <execution>
+#include <vector>
+
+//Параметры поиска близких дубликатов
+struct NearDuplicateOptions {
+    double similarity_threshold = 0.8; //Минимальный коэффициент Жаккара множеств слов двух документов
+    size_t signature_size = 128; //Число MinHash-функций в сигнатуре документа
+};
+
+//Кластеры близких дубликатов: документы, связанные цепочкой пар с коэффициентом Жаккара множеств слов
+//не ниже порога. Пары-кандидаты находятся по MinHash-сигнатурам с LSH-разбиением на полосы и проверяются
+//точным сравнением множеств слов. id в кластере и кластеры (по первому id) упорядочены по возрастанию,
+//документы без слов и документы без близких дубликатов не возвращаются
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options = {});
+
+std::vector<std::vector<int>> FindNearDuplicates(const std::execution::sequenced_policy&,
+    const SearchServer& search_server, const NearDuplicateOptions& options = {});
+std::vector<std::vector<int>> FindNearDuplicates(const std::execution::parallel_policy&,
+    const SearchServer& search_server, const NearDuplicateOptions& options = {});
@@ -0,0 +1,218 @@
+#include "posting_codec.h"
+#include "cpu_features.h"
+#include <cstring>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+    uint32_t LoadValue(const uint8_t* in, uint8_t width) {
+        uint32_t value = in[0];
+        if (width > 1) {
+            value |= static_cast<uint32_t>(in[1]) << 8;
+        }
+        if (width > 2) {
+            value |= static_cast<uint32_t>(in[2]) << 16 | static_cast<uint32_t>(in[3]) << 24;
+        }
+        return value;
+    }
+
+    void UnpackValuesScalar(const uint8_t* in, size_t count, uint8_t width, uint32_t* out) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = LoadValue(in + i * width, width);
+        }
+    }
+
+    void UnpackDeltasScalar(const uint8_t* in, size_t count, uint8_t width, uint32_t base, uint32_t* out) {
+        for (size_t i = 0; i < count; ++i) {
+            base += LoadValue(in + i * width, width);
+            out[i] = base;
+        }
+    }
+
+#ifdef CPU_FEATURES_X86
+    //Расширение до 4 значений uint32 из позиции in (SSE2)
+    CPU_TARGET("sse2")
+    __m128i LoadWidened4(const uint8_t* in, uint8_t width) {
+        const __m128i zero = _mm_setzero_si128();
+        if (width == 1) {
+            int32_t packed;
+            memcpy(&packed, in, sizeof(packed));
+            const __m128i bytes = _mm_cvtsi32_si128(packed);
+            return _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+        }
+        if (width == 2) {
+            return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)), zero);
+        }
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    }
+
+    CPU_TARGET("sse2")
+    void UnpackValuesSse2(const uint8_t* in, size_t count, uint8_t width, uint32_t* out) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), LoadWidened4(in + i * width, width));
+        }
+        UnpackValuesScalar(in + i * width, count - i, width, out + i);
+    }
+
+    //Префиксная сумма по 4 элементам: два сдвига со сложением, затем перенос суммы предыдущей группы
+    CPU_TARGET("sse2")
+    void UnpackDeltasSse2(const uint8_t* in, size_t count, uint8_t width, uint32_t base, uint32_t* out) {
+        __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i values = LoadWidened4(in + i * width, width);
+            values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+            values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+            values = _mm_add_epi32(values, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), values);
+            carry = _mm_shuffle_epi32(values, 0xFF);
+        }
+        if (i < count) {
+            UnpackDeltasScalar(in + i * width, count - i, width, i == 0 ? base : out[i - 1], out + i);
+        }
+    }
+
+    //Расширение до 8 значений uint32 из позиции in (AVX2)
+    CPU_TARGET("avx2")
+    __m256i LoadWidened8(const uint8_t* in, uint8_t width) {
+        if (width == 1) {
+            return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)));
+        }
+        if (width == 2) {
+            return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+        }
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    }
+
+    CPU_TARGET("avx2")
+    void UnpackValuesAvx2(const uint8_t* in, size_t count, uint8_t width, uint32_t* out) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), LoadWidened8(in + i * width, width));
+        }
+        UnpackValuesScalar(in + i * width, count - i, width, out + i);
+    }
+
+    //Префиксная сумма по 8 элементам: суммы внутри 128-битных половин, затем перенос из младшей половины в старшую
+    CPU_TARGET("avx2")
+    void UnpackDeltasAvx2(const uint8_t* in, size_t count, uint8_t width, uint32_t base, uint32_t* out) {
+        __m256i carry = _mm256_set1_epi32(static_cast<int>(base));
+        const __m256i last_lane = _mm256_set1_epi32(7);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i values = LoadWidened8(in + i * width, width);
+            values = _mm256_add_epi32(values, _mm256_slli_si256(values, 4));
+            values = _mm256_add_epi32(values, _mm256_slli_si256(values, 8));
+            const __m256i low_total = _mm256_shuffle_epi32(values, 0xFF);
+            values = _mm256_add_epi32(values, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+            values = _mm256_add_epi32(values, carry);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), values);
+            carry = _mm256_permutevar8x32_epi32(values, last_lane);
+        }
+        if (i < count) {
+            UnpackDeltasScalar(in + i * width, count - i, width, i == 0 ? base : out[i - 1], out + i);
+        }
+    }
+#endif
+
+    struct UnpackKernels {
+        void (*values)(const uint8_t*, size_t, uint8_t, uint32_t*);
+        void (*deltas)(const uint8_t*, size_t, uint8_t, uint32_t, uint32_t*);
+        const char* name;
+    };
+
+    UnpackKernels SelectKernels() {
+#ifdef CPU_FEATURES_X86
+        const CpuFeatures& features = GetCpuFeatures();
+        if (features.avx2) {
+            return { UnpackValuesAvx2, UnpackDeltasAvx2, "avx2" };
+        }
+        if (features.sse2) {
+            return { UnpackValuesSse2, UnpackDeltasSse2, "sse2" };
+        }
+#endif
+        return { UnpackValuesScalar, UnpackDeltasScalar, "scalar" };
+    }
+
+    const UnpackKernels& GetKernels() {
+        static const UnpackKernels kernels = SelectKernels();
+        return kernels;
+    }
+}
+
+//Минимальная ширина (1, 2 или 4 байта), в которую помещается max_value
+uint8_t ChoosePackWidth(uint32_t max_value) {
+    if (max_value <= 0xFF) {
+        return 1;
+    }
+    if (max_value <= 0xFFFF) {
+        return 2;
+    }
+    return 4;
+}
+
+//Дописывание count значений шириной width байт (little-endian) в конец out
+void PackValues(const uint32_t* values, size_t count, uint8_t width, vector<uint8_t>& out) {
+    for (size_t i = 0; i < count; ++i) {
+        for (uint8_t byte = 0; byte < width; ++byte) {
+            out.push_back(static_cast<uint8_t>(values[i] >> (8 * byte)));
+        }
+    }
+}
+
+//Распаковка count значений шириной width байт
+void UnpackValues(const uint8_t* in, size_t count, uint8_t width, uint32_t* out) {
+    GetKernels().values(in, count, width, out);
+}
+
+//Распаковка разностей с восстановлением значений: out[i] = base + deltas[0] + ... + deltas[i]
+void UnpackDeltas(const uint8_t* in, size_t count, uint8_t width, uint32_t base, uint32_t* out) {
+    GetKernels().deltas(in, count, width, base, out);
+}
+
+//Дописывание числа в формате varint (7 бит на байт, старший бит - признак продолжения)
+void AppendVarint(uint32_t value, vector<uint8_t>& out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+//Чтение числа varint; возвращает указатель на следующий байт
+const uint8_t* ReadVarint(const uint8_t* in, uint32_t& value) {
+    value = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return in;
+        }
+    }
+}
+
+//Чтение числа varint с проверкой границы: не больше 5 байт, старшие биты пятого байта нулевые
+bool ReadVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && in != end; shift += 7) {
+        const uint8_t byte = *in++;
+        if (shift == 28 && byte > 0x0F) {
+            return false;
+        }
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Название выбранного ядра распаковки ("avx2", "sse2" или "scalar")
+const char* GetUnpackKernelName() {
+    return GetKernels().name;
+}
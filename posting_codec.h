@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Кодирование словопозиций: полные блоки хранят значения фиксированной ширины (1, 2 или 4 байта),
+//открытый хвост списка - в varint. Распаковка блоков выбирает AVX2, SSE2 или скалярное ядро
+//во время выполнения по возможностям процессора
+
+//Минимальная ширина (1, 2 или 4 байта), в которую помещается max_value
+uint8_t ChoosePackWidth(uint32_t max_value);
+
+//Дописывание count значений шириной width байт (little-endian) в конец out
+void PackValues(const uint32_t* values, size_t count, uint8_t width, std::vector<uint8_t>& out);
+
+//Распаковка count значений шириной width байт
+void UnpackValues(const uint8_t* in, size_t count, uint8_t width, uint32_t* out);
+
+//Распаковка разностей с восстановлением значений: out[i] = base + deltas[0] + ... + deltas[i]
+void UnpackDeltas(const uint8_t* in, size_t count, uint8_t width, uint32_t base, uint32_t* out);
+
+//Дописывание числа в формате varint (7 бит на байт, старший бит - признак продолжения)
+void AppendVarint(uint32_t value, std::vector<uint8_t>& out);
+
+//Чтение числа varint; возвращает указатель на следующий байт
+const uint8_t* ReadVarint(const uint8_t* in, uint32_t& value);
+
+//Чтение числа varint из [in, end) со сдвигом in за число; false, если число не завершено до end
+//или не помещается в uint32_t (данные из непроверенного источника)
+bool ReadVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value);
+
+//Название выбранного ядра распаковки ("avx2", "sse2" или "scalar")
+const char* GetUnpackKernelName();
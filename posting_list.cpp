@@ -0,0 +1,211 @@
+#include "posting_list.h"
+#include "posting_codec.h"
+#include "snapshot_io.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+//Добавление документа с номером больше всех уже имеющихся в списке
+void PostingList::Append(DocumentOrdinal ordinal, uint32_t count) {
+    assert(size_ == 0 || ordinal > last_ordinal_);
+    Unmap();
+    if (tail_size_ == 0) {
+        tail_offset_ = static_cast<uint32_t>(bytes_.size());
+        tail_base_ = size_ == 0 ? 0 : last_ordinal_;
+    }
+    const DocumentOrdinal previous = tail_size_ == 0 ? tail_base_ : last_ordinal_;
+    AppendVarint(ordinal - previous, bytes_);
+    AppendVarint(count, bytes_);
+    ++tail_size_;
+    ++size_;
+    last_ordinal_ = ordinal;
+    if (tail_size_ == BLOCK_SIZE) {
+        SealTail();
+    }
+}
+
+//Проверка наличия документа в списке (поиск блока по заголовкам, затем распаковка одного блока)
+bool PostingList::Contains(DocumentOrdinal ordinal) const {
+    uint32_t ordinals[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    size_t size = 0;
+    const size_t block_index = FindBlock(ordinal);
+    if (block_index < GetBlockCount()) {
+        const Block& block = GetBlocks()[block_index];
+        if (ordinal < block.first) {
+            return false;
+        }
+        UnpackDeltas(GetBytes() + block.offset, block.size, block.delta_width, block.first, ordinals);
+        size = block.size;
+    }
+    else if (tail_size_ != 0 && ordinal <= last_ordinal_) {
+        DecodeTail(ordinals, counts);
+        size = tail_size_;
+    }
+    return binary_search(ordinals, ordinals + size, ordinal);
+}
+
+//Индекс первого блока, последний документ которого не меньше ordinal
+size_t PostingList::FindBlock(DocumentOrdinal ordinal) const {
+    const Block* blocks = GetBlocks();
+    return partition_point(blocks, blocks + GetBlockCount(), [ordinal](const Block& block) {
+        return block.last < ordinal;
+        }) - blocks;
+}
+
+void PostingList::DecodeBlock(const Block& block, uint32_t* ordinals, uint32_t* counts) const {
+    const uint8_t* data = GetBytes() + block.offset;
+    UnpackDeltas(data, block.size, block.delta_width, block.first, ordinals);
+    UnpackValues(data + static_cast<size_t>(block.size) * block.delta_width, block.size, block.count_width, counts);
+}
+
+void PostingList::DecodeTail(uint32_t* ordinals, uint32_t* counts) const {
+    const uint8_t* data = GetBytes() + tail_offset_;
+    DocumentOrdinal ordinal = tail_base_;
+    for (uint32_t i = 0; i < tail_size_; ++i) {
+        uint32_t delta;
+        data = ReadVarint(data, delta);
+        data = ReadVarint(data, counts[i]);
+        ordinal += delta;
+        ordinals[i] = ordinal;
+    }
+}
+
+//Упаковка словопозиций в конец out
+PostingList::Block PostingList::EncodeBlock(const uint32_t* ordinals, const uint32_t* counts, size_t size, vector<uint8_t>& out) {
+    uint32_t deltas[BLOCK_SIZE];
+    deltas[0] = 0;
+    uint32_t max_delta = 0;
+    for (size_t i = 1; i < size; ++i) {
+        deltas[i] = ordinals[i] - ordinals[i - 1];
+        max_delta = max(max_delta, deltas[i]);
+    }
+    const uint32_t max_count = *max_element(counts, counts + size);
+
+    Block block;
+    block.first = ordinals[0];
+    block.last = ordinals[size - 1];
+    block.offset = static_cast<uint32_t>(out.size());
+    block.size = static_cast<uint16_t>(size);
+    block.delta_width = ChoosePackWidth(max_delta);
+    block.count_width = ChoosePackWidth(max_count);
+    PackValues(deltas, size, block.delta_width, out);
+    PackValues(counts, size, block.count_width, out);
+    return block;
+}
+
+//Перенос полного хвоста в упакованный блок
+void PostingList::SealTail() {
+    uint32_t ordinals[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    DecodeTail(ordinals, counts);
+    bytes_.resize(tail_offset_);
+    blocks_.push_back(EncodeBlock(ordinals, counts, tail_size_, bytes_));
+    tail_size_ = 0;
+    tail_offset_ = static_cast<uint32_t>(bytes_.size());
+}
+
+//Заголовок списка в снимке
+struct MappedPostingListHeader {
+    uint64_t size;
+    uint32_t last_ordinal;
+    uint32_t tail_offset;
+    uint32_t tail_size;
+    uint32_t tail_base;
+    uint32_t block_count;
+    uint32_t byte_count;
+};
+
+//Запись списка в снимок: заголовок, заголовки блоков и сжатые данные как есть
+void PostingList::Save(SnapshotWriter& writer) const {
+    static_assert(sizeof(Block) == 16, "Block header must have no padding");
+    writer.Write(MappedPostingListHeader{
+        size_,
+        last_ordinal_,
+        tail_offset_,
+        tail_size_,
+        tail_base_,
+        static_cast<uint32_t>(GetBlockCount()),
+        static_cast<uint32_t>(GetByteCount())
+        });
+    writer.WriteArray(GetBlocks(), GetBlockCount());
+    writer.WriteArray(GetBytes(), GetByteCount());
+}
+
+//Список поверх данных снимка без копирования. Данные проверяются целиком: блоки распаковываются один раз,
+//хвост читается с границей, поэтому испорченный снимок не приводит к чтению за концом данных списка
+//или к номерам документов вне сегмента
+PostingList PostingList::Map(SnapshotReader& reader, DocumentOrdinal first_ordinal, DocumentOrdinal end_ordinal) {
+    const auto header = reader.Read<MappedPostingListHeader>();
+    PostingList postings;
+    postings.size_ = static_cast<size_t>(header.size);
+    postings.last_ordinal_ = header.last_ordinal;
+    postings.tail_offset_ = header.tail_offset;
+    postings.tail_size_ = header.tail_size;
+    postings.tail_base_ = header.tail_base;
+    postings.mapped_blocks_ = reader.ReadArray<Block>(header.block_count);
+    postings.mapped_bytes_ = reader.ReadArray<uint8_t>(header.byte_count);
+    postings.mapped_block_count_ = header.block_count;
+    postings.mapped_byte_count_ = header.byte_count;
+    CheckSnapshot(header.tail_size < BLOCK_SIZE && header.tail_offset <= header.byte_count);
+
+    //Блок занимает size * (delta_width + count_width) байт до начала хвоста, его номера строго возрастают
+    //от first до last и больше номеров предыдущего блока
+    alignas(32) uint32_t ordinals[BLOCK_SIZE];
+    alignas(32) uint32_t counts[BLOCK_SIZE];
+    size_t block_postings = 0;
+    for (uint32_t i = 0; i < header.block_count; ++i) {
+        const Block& block = postings.mapped_blocks_[i];
+        const bool is_valid_width = block.delta_width == 1 || block.delta_width == 2 || block.delta_width == 4;
+        const bool is_valid_count_width = block.count_width == 1 || block.count_width == 2 || block.count_width == 4;
+        CheckSnapshot(is_valid_width && is_valid_count_width && block.size != 0 && block.size <= BLOCK_SIZE && block.first <= block.last
+            && static_cast<size_t>(block.offset) + static_cast<size_t>(block.size) * (block.delta_width + block.count_width) <= header.tail_offset
+            && (i == 0 ? block.first >= first_ordinal : block.first > postings.mapped_blocks_[i - 1].last));
+        postings.DecodeBlock(block, ordinals, counts);
+        for (size_t j = 1; j < block.size; ++j) {
+            CheckSnapshot(ordinals[j - 1] < ordinals[j]);
+        }
+        CheckSnapshot(ordinals[block.size - 1] == block.last);
+        block_postings += block.size;
+    }
+    CheckSnapshot(block_postings + header.tail_size == postings.size_);
+
+    //Хвост - ровно tail_size пар varint до конца данных; его номера строго возрастают и больше номеров блоков
+    const DocumentOrdinal blocks_last = header.block_count == 0 ? 0 : postings.mapped_blocks_[header.block_count - 1].last;
+    const uint8_t* data = postings.mapped_bytes_ + header.tail_offset;
+    const uint8_t* const data_end = postings.mapped_bytes_ + header.byte_count;
+    uint64_t ordinal = header.tail_base;
+    for (uint32_t i = 0; i < header.tail_size; ++i) {
+        uint32_t delta;
+        uint32_t count;
+        CheckSnapshot(ReadVarint(data, data_end, delta) && ReadVarint(data, data_end, count));
+        ordinal += delta;
+        if (i == 0) {
+            CheckSnapshot(header.block_count == 0 ? ordinal >= first_ordinal : ordinal > blocks_last);
+        }
+        else {
+            CheckSnapshot(delta != 0);
+        }
+    }
+    CheckSnapshot(data == data_end && header.last_ordinal == (header.tail_size != 0 ? ordinal : blocks_last));
+    CheckSnapshot(postings.size_ == 0 || header.last_ordinal < end_ordinal);
+
+    if (header.block_count == 0 && header.tail_size == 0) {
+        postings.mapped_blocks_ = nullptr;
+    }
+    return postings;
+}
+
+//Копирование данных снимка в собственные векторы перед изменением списка
+void PostingList::Unmap() {
+    if (mapped_blocks_ == nullptr) {
+        return;
+    }
+    blocks_.assign(mapped_blocks_, mapped_blocks_ + mapped_block_count_);
+    bytes_.assign(mapped_bytes_, mapped_bytes_ + mapped_byte_count_);
+    mapped_blocks_ = nullptr;
+    mapped_bytes_ = nullptr;
+    mapped_block_count_ = 0;
+    mapped_byte_count_ = 0;
+}
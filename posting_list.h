@@ -0,0 +1,145 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+class SnapshotWriter;
+class SnapshotReader;
+
+//Внутренний порядковый номер документа (индекс в плоских массивах SearchServer)
+using DocumentOrdinal = uint32_t;
+
+//Сжатый список словопозиций слова, отсортированный по номеру документа.
+//Каждая словопозиция - номер документа и число вхождений слова в него (TF = число вхождений / длина документа).
+//Полные блоки по BLOCK_SIZE словопозиций хранят разности номеров и числа вхождений упакованными
+//в 1, 2 или 4 байта и распаковываются SIMD-ядрами; последние словопозиции (хвост) дописываются в varint.
+//Список, загруженный из снимка, читает блоки прямо из отображенной памяти и копирует их только перед изменением
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    //Добавление документа с номером больше всех уже имеющихся в списке
+    void Append(DocumentOrdinal ordinal, uint32_t count);
+
+    //Проверка наличия документа в списке (поиск блока по заголовкам, затем распаковка одного блока)
+    bool Contains(DocumentOrdinal ordinal) const;
+
+    //Запись списка в снимок: заголовок, заголовки блоков и сжатые данные как есть
+    void Save(SnapshotWriter& writer) const;
+
+    //Список поверх данных снимка без копирования; память снимка должна жить дольше списка.
+    //Данные проверяются при загрузке: номера документов должны лежать в [first_ordinal, end_ordinal)
+    static PostingList Map(SnapshotReader& reader, DocumentOrdinal first_ordinal, DocumentOrdinal end_ordinal);
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    //Объем сжатых данных и заголовков блоков в байтах
+    size_t GetEncodedSize() const {
+        return GetByteCount() + GetBlockCount() * sizeof(Block);
+    }
+
+    //Освобождение запаса памяти векторов (для списков, которые больше не дописываются)
+    void ShrinkToFit() {
+        blocks_.shrink_to_fit();
+        bytes_.shrink_to_fit();
+    }
+
+    //Обход всех словопозиций: function(ordinal, count)
+    template <typename Function>
+    void ForEach(Function function) const {
+        ForEachInRange(0, std::numeric_limits<DocumentOrdinal>::max(), function);
+    }
+
+    //Обход словопозиций документов с номерами из [first, last): function(ordinal, count).
+    //Блоки вне диапазона пропускаются по заголовкам без распаковки
+    template <typename Function>
+    void ForEachInRange(DocumentOrdinal first, DocumentOrdinal last, Function function) const {
+        alignas(32) uint32_t ordinals[BLOCK_SIZE];
+        alignas(32) uint32_t counts[BLOCK_SIZE];
+        const Block* blocks = GetBlocks();
+        const size_t block_count = GetBlockCount();
+        for (size_t block = FindBlock(first); block < block_count && blocks[block].first < last; ++block) {
+            DecodeBlock(blocks[block], ordinals, counts);
+            VisitRange(ordinals, counts, blocks[block].size, first, last, function);
+        }
+        if (tail_size_ != 0 && last_ordinal_ >= first) {
+            DecodeTail(ordinals, counts);
+            VisitRange(ordinals, counts, tail_size_, first, last, function);
+        }
+    }
+
+private:
+    struct Block {
+        DocumentOrdinal first; //Номер первого документа блока - основание для разностей
+        DocumentOrdinal last;
+        uint32_t offset; //Смещение блока в bytes_
+        uint16_t size;
+        uint8_t delta_width;
+        uint8_t count_width;
+    };
+
+    std::vector<Block> blocks_;
+    std::vector<uint8_t> bytes_; //Упакованные блоки подряд, за ними varint-хвост
+    //Те же данные в памяти снимка; при mapped_blocks_ == nullptr данные лежат в blocks_ и bytes_
+    const Block* mapped_blocks_ = nullptr;
+    const uint8_t* mapped_bytes_ = nullptr;
+    uint32_t mapped_block_count_ = 0;
+    uint32_t mapped_byte_count_ = 0;
+    uint32_t tail_offset_ = 0;
+    uint32_t tail_size_ = 0;
+    DocumentOrdinal tail_base_ = 0; //От него отсчитывается разность первой словопозиции хвоста
+    DocumentOrdinal last_ordinal_ = 0;
+    size_t size_ = 0;
+
+    const Block* GetBlocks() const {
+        return mapped_blocks_ ? mapped_blocks_ : blocks_.data();
+    }
+
+    size_t GetBlockCount() const {
+        return mapped_blocks_ ? mapped_block_count_ : blocks_.size();
+    }
+
+    const uint8_t* GetBytes() const {
+        return mapped_blocks_ ? mapped_bytes_ : bytes_.data();
+    }
+
+    size_t GetByteCount() const {
+        return mapped_blocks_ ? mapped_byte_count_ : bytes_.size();
+    }
+
+    //Копирование данных снимка в собственные векторы перед изменением списка
+    void Unmap();
+
+    template <typename Function>
+    static void VisitRange(const uint32_t* ordinals, const uint32_t* counts, size_t size,
+        DocumentOrdinal first, DocumentOrdinal last, Function& function) {
+        for (size_t i = 0; i < size; ++i) {
+            if (ordinals[i] < first) {
+                continue;
+            }
+            if (ordinals[i] >= last) {
+                break;
+            }
+            function(static_cast<DocumentOrdinal>(ordinals[i]), counts[i]);
+        }
+    }
+
+    //Индекс первого блока, последний документ которого не меньше ordinal
+    size_t FindBlock(DocumentOrdinal ordinal) const;
+
+    void DecodeBlock(const Block& block, uint32_t* ordinals, uint32_t* counts) const;
+    void DecodeTail(uint32_t* ordinals, uint32_t* counts) const;
+
+    //Упаковка словопозиций в конец out
+    static Block EncodeBlock(const uint32_t* ordinals, const uint32_t* counts, size_t size, std::vector<uint8_t>& out);
+
+    //Перенос полного хвоста в упакованный блок
+    void SealTail();
+};
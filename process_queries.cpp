@@ -1,4 +1,5 @@
 #include "process_queries.h"
+#include <algorithm>
 #include <execution>
 #include <numeric>
 
@@ -8,22 +9,70 @@ using namespace std;
 vector<vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const vector<string>& queries) {
-    vector<vector<Document>> result(queries.size());
-    transform(execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const auto& query) {return search_server.FindTopDocuments(query); });
-    return result;
+    //Пакетный поиск распаковывает список каждого слова один раз на группу запросов, а не на каждый запрос
+    return search_server.FindTopDocumentsBatch(execution::par, queries);
 }
 
-vector <Document> ProcessQueriesJoined(
+namespace {
+    //Склейка выдач в joined в порядке запросов: смещение выдачи - сумма размеров предыдущих,
+    //поэтому потоки пишут в непересекающиеся части вектора
+    void JoinResults(const vector<vector<Document>>& results, vector<Document>& joined) {
+        vector<size_t> offsets(results.size());
+        transform_exclusive_scan(results.begin(), results.end(), offsets.begin(), size_t{ 0 }, plus<>(), [](const vector<Document>& documents) {
+            return documents.size();
+            });
+        joined.resize(results.empty() ? 0 : offsets.back() + results.back().size());
+        vector<size_t> indexes(results.size());
+        iota(indexes.begin(), indexes.end(), 0);
+        for_each(execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+            copy(results[i].begin(), results[i].end(), joined.begin() + offsets[i]);
+            });
+    }
+}
+
+vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const vector<string>& queries) {
-    return transform_reduce(execution::par, 
-        queries.begin(), queries.end(), 
-        vector<Document>(),
-        [](vector<Document> lhs, vector<Document> rhs) {
-            lhs.insert(lhs.end(), rhs.begin(), rhs.end());
-            return lhs; 
-        },
-        [&search_server](const auto& query) {
-            return search_server.FindTopDocuments(query); 
-        });
-}
\ No newline at end of file
+    vector<Document> joined;
+    JoinResults(ProcessQueries(search_server, queries), joined);
+    return joined;
+}
+
+JoinedQueryResults::JoinedQueryResults(const SearchServer& search_server, vector<string> queries, size_t batch_size)
+    : search_server_(search_server)
+    , queries_(move(queries))
+    , batch_size_(max<size_t>(batch_size, 1)) {
+}
+
+JoinedQueryResults::Iterator JoinedQueryResults::begin() {
+    return LoadNextBatch() ? Iterator(this) : end();
+}
+
+//Пакеты, все запросы которых ничего не нашли, пропускаются; вектор выдач переиспользуется между пакетами
+bool JoinedQueryResults::LoadNextBatch() {
+    documents_.clear();
+    while (documents_.empty() && next_query_ < queries_.size()) {
+        const size_t batch_end = min(next_query_ + batch_size_, queries_.size());
+        const auto first = queries_.cbegin() + next_query_;
+        next_query_ = batch_end;
+        JoinResults(search_server_.FindTopDocumentsBatch(execution::par, first, queries_.cbegin() + batch_end), documents_);
+    }
+    return !documents_.empty();
+}
+
+JoinedQueryResults::Iterator& JoinedQueryResults::Iterator::operator++() {
+    if (++position_ == owner_->documents_.size()) {
+        position_ = 0;
+        if (!owner_->LoadNextBatch()) {
+            owner_ = nullptr;
+        }
+    }
+    return *this;
+}
+
+JoinedQueryResults ProcessQueriesJoinedLazy(
+    const SearchServer& search_server,
+    vector<string> queries,
+    size_t batch_size) {
+    return JoinedQueryResults(search_server, move(queries), batch_size);
+}
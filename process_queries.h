@@ -1,11 +1,91 @@
 #pragma once
 #include "search_server.h"
+#include <iterator>
+#include <string>
+#include <vector>
 
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
-std::vector <Document> ProcessQueriesJoined(
+//Выдачи всех запросов одним вектором в порядке запросов. Смещения выдач считаются префиксными суммами
+//их размеров, и каждая выдача параллельно копируется на свое место в заранее выделенный вектор
+std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+//Ленивая склейка выдач для потоковой обработки: запросы выполняются пакетами по batch_size по мере обхода,
+//в памяти одновременно только выдачи одного пакета. Вектор запросов хранится в объекте, пакеты передаются
+//пакетному поиску отрезками этого вектора без копирования строк. Обход однопроходный (input iterator),
+//begin вызывается один раз; сервер должен жить до конца обхода
+class JoinedQueryResults {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator() = default;
+
+        reference operator*() const {
+            return owner_->documents_[position_];
+        }
+
+        pointer operator->() const {
+            return &owner_->documents_[position_];
+        }
+
+        //Переход к следующему документу; после последнего документа пакета выполняется следующий пакет
+        Iterator& operator++();
+
+        bool operator==(const Iterator& other) const {
+            return owner_ == other.owner_ && position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class JoinedQueryResults;
+
+        JoinedQueryResults* owner_ = nullptr; //nullptr - конец обхода
+        size_t position_ = 0;
+
+        explicit Iterator(JoinedQueryResults* owner)
+            : owner_(owner) {
+        }
+    };
+
+    JoinedQueryResults(const SearchServer& search_server, std::vector<std::string> queries, size_t batch_size);
+
+    JoinedQueryResults(const JoinedQueryResults&) = delete;
+    JoinedQueryResults& operator=(const JoinedQueryResults&) = delete;
+
+    //Выполнение первого пакета
+    Iterator begin();
+
+    Iterator end() {
+        return {};
+    }
+
+private:
+    const SearchServer& search_server_;
+    std::vector<std::string> queries_;
+    size_t batch_size_;
+    size_t next_query_ = 0;
+    std::vector<Document> documents_; //Склеенные выдачи текущего пакета
+
+    //Выполнение пакетов до первого с непустыми выдачами; false, если запросы кончились
+    bool LoadNextBatch();
+};
+
+//Запросы передаются во владение результату: временный вектор можно обходить в том же выражении
+JoinedQueryResults ProcessQueriesJoinedLazy(
+    const SearchServer& search_server,
+    std::vector<std::string> queries,
+    size_t batch_size = 1024);
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include "posting_list.h"
+#include <cstdint>
+#include <vector>
+
+//Плотный накопитель релевантности: массив по номеру документа и список затронутых номеров.
+//Сброс стоит O(затронутых документов), память переиспользуется между запросами
+class RelevanceAccumulator {
+public:
+    //Подготовка к новому запросу по document_count номерам начиная с first_ordinal: часть индекса
+    //занимает массив только под свой диапазон
+    void Reset(size_t document_count, DocumentOrdinal first_ordinal = 0) {
+        for (const DocumentOrdinal offset : touched_) {
+            scores_[offset] = 0.0;
+            states_[offset] = UNTOUCHED;
+        }
+        touched_.clear();
+        first_ordinal_ = first_ordinal;
+        if (scores_.size() < document_count) {
+            scores_.resize(document_count, 0.0);
+            states_.resize(document_count, UNTOUCHED);
+        }
+    }
+
+    //Добавление вклада слова в релевантность документа
+    void Add(DocumentOrdinal ordinal, double relevance) {
+        const DocumentOrdinal offset = ordinal - first_ordinal_;
+        if (states_[offset] == UNTOUCHED) {
+            states_[offset] = SCORED;
+            touched_.push_back(offset);
+        }
+        scores_[offset] += relevance;
+    }
+
+    //Исключение документа (минус-слово); вклады остальных слов игнорируются при обходе
+    void Exclude(DocumentOrdinal ordinal) {
+        const DocumentOrdinal offset = ordinal - first_ordinal_;
+        if (states_[offset] == SCORED) {
+            states_[offset] = EXCLUDED;
+        }
+    }
+
+    //Обход набравших релевантность и не исключенных документов: function(ordinal, relevance)
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const DocumentOrdinal offset : touched_) {
+            if (states_[offset] == SCORED) {
+                function(first_ordinal_ + offset, scores_[offset]);
+            }
+        }
+    }
+
+    size_t TouchedCount() const {
+        return touched_.size();
+    }
+
+private:
+    enum State : uint8_t {
+        UNTOUCHED,
+        SCORED,
+        EXCLUDED,
+    };
+
+    std::vector<double> scores_;
+    std::vector<uint8_t> states_;
+    std::vector<DocumentOrdinal> touched_; //Смещения от first_ordinal_
+    DocumentOrdinal first_ordinal_ = 0;
+};
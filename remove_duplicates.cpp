@@ -3,27 +3,9 @@
 using namespace std;
 
 void RemoveDuplicates(SearchServer& search_server) {
-    set<int> duplicates;
-    set<set<string_view>> docs;
-    for (auto i = search_server.begin(); i != search_server.end(); ++i) {
-        const auto& doc = search_server.GetWordFrequencies(*i);
-        set<string_view> doc_words;
-
-        for (const auto& [word, freq] : doc) {
-            doc_words.insert(word);
-        }//WlogN
-        if (docs.count(doc_words)) {
-            duplicates.insert(*i);
-        }//logN
-        else {
-            docs.insert(doc_words);
-        }//logN
-    }//N*WlogN
-
-
-
-    for (auto id : duplicates) {
+    //Дубликаты находятся по отпечаткам множеств слов, которые сервер поддерживает сам
+    for (const int id : search_server.FindDuplicates()) {
         cout << "Found duplicate document id "s << id << endl;
         search_server.RemoveDocument(id);
     }//N*WlogN
-}
\ No newline at end of file
+}
@@ -1,105 +1,600 @@
 #include "search_server.h"
+#include "snapshot_io.h"
 #include <stdexcept>
 #include <algorithm>
 #include <math.h>
+#include <numeric>
+#include <future>
+#include <thread>
+#include <unordered_set>
 
 using namespace std;
 
+namespace {
+    //Пакетный поиск: не больше стольких запросов в группе
+    constexpr size_t MAX_QUERY_GROUP_SIZE = 32;
+    //Не больше стольких распакованных словопозиций на группу: иначе номера документов обходятся диапазонами,
+    //чтобы память потока не зависела от размера индекса
+    constexpr size_t QUERY_GROUP_POSTING_LIMIT = 1 << 22;
+
+    //Данные документа в снимке (без выравнивающих пропусков)
+    struct SnapshotDocument {
+        int32_t id;
+        int32_t rating;
+        uint32_t status;
+        uint32_t is_removed;
+        double inv_word_count;
+    };
+
+    //Частота слова документа в снимке
+    struct SnapshotTermFrequency {
+        uint32_t term_id;
+        uint32_t reserved;
+        double term_freq;
+    };
+
+    //Документ в теле записи журнала ADD_DOCUMENTS
+    void EncodeDocument(MutationEncoder& body, int document_id, string_view text, DocumentStatus status, const vector<int>& ratings) {
+        body.Put<int32_t>(document_id);
+        body.Put<uint8_t>(static_cast<uint8_t>(status));
+        body.Put<uint32_t>(static_cast<uint32_t>(ratings.size()));
+        for (const int rating : ratings) {
+            body.Put<int32_t>(rating);
+        }
+        body.PutString(text);
+    }
+}
+
 //Возврат количества документов
 size_t SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    shared_lock lock(index_mutex_);
+    return document_ordinals_.size();
 }
 
 //Добавление нового документа
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
-    if (!IsValidWord(document)) {
+    IndexDocument(document_id, document, status, ratings, false);
+}
+
+//Добавление документа, если в сервере нет документа с тем же множеством слов
+bool SearchServer::AddDocumentIfUnique(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
+    return IndexDocument(document_id, document, status, ratings, true);
+}
+
+//Добавление документа; при reject_duplicate документ с уже имеющимся множеством слов не добавляется
+bool SearchServer::IndexDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings, bool reject_duplicate) {
+    //Проверка спецсимволов и разбиение на слова - один проход по тексту
+    vector<string_view> words;
+    const bool is_valid_text = ForEachWord(document, [&](string_view word) {
+        if (!IsStopWord(word)) {
+            words.push_back(word);
+        }
+        });
+    if (!is_valid_text) {
         throw invalid_argument("Document contains special symbols"s);
     }
-    else if (document_id < 0 || documents_.count(document_id)) {
+
+    unique_lock write_lock(write_mutex_);
+    ReserveOrdinals(1);
+    unique_lock index_lock(index_mutex_);
+    if (document_id < 0 || document_ordinals_.count(document_id)) {
         throw invalid_argument("Document_id is negative or already exist"s);
     }
 
-    const auto words = SplitIntoWordsNoStop(document);
     const double inv_word_count = 1.0 / words.size();
 
-    for (const auto& word : words) {
-        auto [a, b] = words_.emplace(word);
-        string_view word_view = *a;
-        word_to_document_freqs_[word_view][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word_view] += inv_word_count;
+    //Слова переводятся в TermId, повторы схлопываются сортировкой.
+    //У дубликата все слова уже есть в словаре, поэтому отклоненный документ словарь не меняет
+    vector<TermId> term_ids;
+    term_ids.reserve(words.size());
+    for (const auto word : words) {
+        term_ids.push_back(terms_.Intern(word));
+    }
+    sort(term_ids.begin(), term_ids.end());
+    ResizeTermArrays();
 
+    DocumentFingerprint fingerprint;
+    for (auto it = term_ids.begin(); it != term_ids.end(); it = upper_bound(it, term_ids.end(), *it)) {
+        fingerprint += term_fingerprints_[*it];
     }
-    documents_.emplace(document_id,
+    if (reject_duplicate && fingerprint_counts_.count(fingerprint)) {
+        return false;
+    }
+
+    //Новый документ получает следующий по порядку номер
+    const auto ordinal = static_cast<DocumentOrdinal>(documents_.size());
+    auto& word_freqs = document_to_word_freqs_.emplace_back();
+    //Каждое слово документа попадает в свой список словопозиций один раз - с числом вхождений
+    for (auto it = term_ids.begin(); it != term_ids.end();) {
+        const auto next = upper_bound(it, term_ids.end(), *it);
+        const auto count = static_cast<uint32_t>(next - it);
+        word_freqs.push_back({ *it, count * inv_word_count });
+        open_segment_.AddTerm(*it).Append(ordinal, count);
+        ++document_freqs_[*it];
+        UpdateDocumentFreq(*it);
+        it = next;
+    }
+    posting_count_ += word_freqs.size();
+    documents_.push_back(
         DocumentData{
+            document_id,
             ComputeAverageRating(ratings),
-            status
+            status,
+            false,
+            inv_word_count
         });
+    document_ordinals_.emplace(document_id, ordinal);
     document_ids_.insert(document_id);
+    document_fingerprints_.push_back(fingerprint);
+    ++fingerprint_counts_[fingerprint];
+    StoreDocumentText(ordinal, document);
+    log_document_count_ = log(static_cast<double>(document_ordinals_.size()));
+    open_segment_.SetEndOrdinal(ordinal + 1u);
+    FreezeFullOpenSegment();
+    index_lock.unlock();
+
+    //Запись журнала кодируется, пока запросы уже идут, а ожидание диска не держит и write_mutex_
+    const LogTicket ticket = LogMutation(MutationType::ADD_DOCUMENTS, [&](MutationEncoder& body) {
+        body.Put<uint32_t>(1);
+        EncodeDocument(body, document_id, document, status, ratings);
+        });
+    write_lock.unlock();
+    ticket.Wait();
+    return true;
 }
 
-//Метод возврата списка совпавших слов запроса
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+//Пакетное добавление документов
+void SearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    AddDocuments(execution::par, documents);
+}
+
+void SearchServer::AddDocuments(const execution::sequenced_policy&, const vector<NewDocument>& documents) {
+    AddDocumentsBatch(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(const execution::parallel_policy&, const vector<NewDocument>& documents) {
+    AddDocumentsBatch(execution::par, documents);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentsBatch(ExecutionPolicy&& policy, const vector<NewDocument>& documents) {
+    struct ShardPosting {
+        TermId term_id;
+        DocumentOrdinal ordinal;
+        uint32_t count;
+    };
+    //Частичный индекс части пакета: собственный словарь и слова документов с числом вхождений
+    struct PartialIndex {
+        size_t first = 0;
+        size_t last = 0;
+        unordered_map<string_view, TermId> local_ids; //"Слово" - "Локальный номер"
+        vector<string_view> words; //"Локальный номер" - "Слово"
+        vector<vector<pair<TermId, uint32_t>>> document_terms; //Слова документа с числом вхождений
+        vector<TermId> term_ids; //"Локальный номер" - "TermId" основного словаря
+        vector<vector<ShardPosting>> shard_postings; //Словопозиции части по сегментам слов
+    };
+    const size_t part_count = GetIndexingPartCount(documents.size());
+    vector<PartialIndex> parts(part_count);
+    for (size_t part = 0; part < part_count; ++part) {
+        parts[part].first = documents.size() * part / part_count;
+        parts[part].last = documents.size() * (part + 1) / part_count;
+    }
 
-    Query query = ParseQuery(raw_query);
-    set<string_view> BingoWords = {}; //Чтобы не сортировать и не проверять на совпадение
+    //Разбиение на слова с проверкой спецсимволов: каждая часть работает только со своим словарем.
+    //Исключения нельзя бросать из параллельного алгоритма, поэтому запоминаются только признаки корректности текста
+    vector<char> valid_texts(documents.size());
+    for_each(policy, parts.begin(), parts.end(), [&](PartialIndex& part) {
+        part.document_terms.resize(part.last - part.first);
+        vector<TermId> local_ids;
+        for (size_t i = part.first; i < part.last; ++i) {
+            local_ids.clear();
+            valid_texts[i] = ForEachWord(documents[i].text, [&](string_view word) {
+                if (IsStopWord(word)) {
+                    return;
+                }
+                const auto [it, inserted] = part.local_ids.emplace(word, static_cast<TermId>(part.words.size()));
+                if (inserted) {
+                    part.words.push_back(word);
+                }
+                local_ids.push_back(it->second);
+                });
+            sort(local_ids.begin(), local_ids.end());
+            auto& terms = part.document_terms[i - part.first];
+            for (auto it = local_ids.begin(); it != local_ids.end();) {
+                const auto next = upper_bound(it, local_ids.end(), *it);
+                terms.push_back({ *it, static_cast<uint32_t>(next - it) });
+                it = next;
+            }
+        }
+        });
 
-    //Обработка вектора плюс-слов
-    for (const auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)) {
-            BingoWords.insert(word);
+    //Разбиение на слова шло без блокировок, слияние в индекс - одна монопольная запись.
+    //Проверки в порядке AddDocument до первого изменения индекса
+    unique_lock write_lock(write_mutex_);
+    ReserveOrdinals(documents.size());
+    unique_lock index_lock(index_mutex_);
+    unordered_set<int> batch_ids;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (!valid_texts[i]) {
+            throw invalid_argument("Document contains special symbols"s);
+        }
+        const int document_id = documents[i].id;
+        if (document_id < 0 || document_ordinals_.count(document_id) || !batch_ids.insert(document_id).second) {
+            throw invalid_argument("Document_id is negative or already exist"s);
         }
     }
 
-    //Исключение документов с минус-словами
-    for (const auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)) {
-            BingoWords.clear();
+    //Слияние словарей: каждое слово части переводится в основной словарь один раз
+    for (PartialIndex& part : parts) {
+        part.term_ids.reserve(part.words.size());
+        for (const auto word : part.words) {
+            part.term_ids.push_back(terms_.Intern(word));
+        }
+    }
+    ResizeTermArrays();
+
+    //Документы пакета получают номера подряд, в порядке пакета
+    const auto first_ordinal = static_cast<DocumentOrdinal>(documents_.size());
+    documents_.resize(documents_.size() + documents.size());
+    document_to_word_freqs_.resize(document_to_word_freqs_.size() + documents.size());
+    document_fingerprints_.resize(document_fingerprints_.size() + documents.size());
+    const size_t shard_count = part_count;
+    for_each(policy, parts.begin(), parts.end(), [&](PartialIndex& part) {
+        part.shard_postings.resize(shard_count);
+        for (size_t i = part.first; i < part.last; ++i) {
+            auto& terms = part.document_terms[i - part.first];
+            uint32_t word_count = 0;
+            for (auto& [term_id, count] : terms) {
+                term_id = part.term_ids[term_id];
+                word_count += count;
+            }
+            sort(terms.begin(), terms.end());
+
+            const double inv_word_count = 1.0 / word_count;
+            const NewDocument& document = documents[i];
+            const DocumentOrdinal ordinal = first_ordinal + static_cast<DocumentOrdinal>(i);
+            auto& word_freqs = document_to_word_freqs_[ordinal];
+            word_freqs.reserve(terms.size());
+            DocumentFingerprint& fingerprint = document_fingerprints_[ordinal];
+            for (const auto& [term_id, count] : terms) {
+                word_freqs.push_back({ term_id, count * inv_word_count });
+                fingerprint += term_fingerprints_[term_id];
+                part.shard_postings[term_id % shard_count].push_back({ term_id, ordinal, count });
+            }
+            documents_[ordinal] = DocumentData{
+                document.id,
+                ComputeAverageRating(document.ratings),
+                document.status,
+                false,
+                inv_word_count
+            };
+        }
+        });
+
+    //Списки слов пакета заводятся в открытом сегменте заранее: дальше сегмент только дописывается
+    for (const PartialIndex& part : parts) {
+        for (const TermId term_id : part.term_ids) {
+            open_segment_.AddTerm(term_id);
         }
     }
-    vector<string_view> v(BingoWords.begin(), BingoWords.end());
-    return tuple(v, documents_.at(document_id).status);
+
+    //Словопозиции дописываются группами слов: список слова меняет только поток его группы,
+    //части обходятся по порядку, поэтому номера документов в списках возрастают
+    vector<size_t> shards(shard_count);
+    iota(shards.begin(), shards.end(), 0);
+    for_each(policy, shards.begin(), shards.end(), [&](size_t shard) {
+        vector<TermId> touched_terms;
+        for (const PartialIndex& part : parts) {
+            for (const auto [term_id, ordinal, count] : part.shard_postings[shard]) {
+                open_segment_.GetPostings(term_id).Append(ordinal, count);
+                ++document_freqs_[term_id];
+                touched_terms.push_back(term_id);
+            }
+        }
+        sort(touched_terms.begin(), touched_terms.end());
+        touched_terms.erase(unique(touched_terms.begin(), touched_terms.end()), touched_terms.end());
+        for (const TermId term_id : touched_terms) {
+            UpdateDocumentFreq(term_id);
+        }
+        });
+
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const DocumentOrdinal ordinal = first_ordinal + static_cast<DocumentOrdinal>(i);
+        document_ordinals_.emplace(documents[i].id, ordinal);
+        document_ids_.insert(documents[i].id);
+        ++fingerprint_counts_[document_fingerprints_[ordinal]];
+        posting_count_ += document_to_word_freqs_[ordinal].size();
+        StoreDocumentText(ordinal, documents[i].text);
+    }
+    if (!document_ordinals_.empty()) {
+        log_document_count_ = log(static_cast<double>(document_ordinals_.size()));
+    }
+    open_segment_.SetEndOrdinal(static_cast<DocumentOrdinal>(documents_.size()));
+    FreezeFullOpenSegment();
+    index_lock.unlock();
+
+    //Пакет - одна запись журнала
+    const LogTicket ticket = LogMutation(MutationType::ADD_DOCUMENTS, [&](MutationEncoder& body) {
+        body.Put<uint32_t>(static_cast<uint32_t>(documents.size()));
+        for (const NewDocument& document : documents) {
+            EncodeDocument(body, document.id, document.text, document.status, document.ratings);
+        }
+        });
+    write_lock.unlock();
+    ticket.Wait();
 }
 
+//Хранение текстов документов в сервере; действует на документы, добавленные после вызова
+void SearchServer::SetDocumentTextStorage(bool enabled) {
+    unique_lock write_lock(write_mutex_);
+    store_document_texts_ = enabled;
+    const LogTicket ticket = LogMutation(MutationType::SET_TEXT_STORAGE, [&](MutationEncoder& body) {
+        body.Put<uint8_t>(enabled);
+        });
+    write_lock.unlock();
+    ticket.Wait();
+}
 
-std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, const string_view raw_query, int document_id) const {
-    return SearchServer::MatchDocument(raw_query, document_id);
+//Текст документа, если при добавлении документа хранение текстов было включено, иначе пустая строка
+string_view SearchServer::GetDocumentText(int document_id) const {
+    shared_lock lock(index_mutex_);
+    const auto ordinal = GetDocumentOrdinal(document_id);
+    return ordinal < document_texts_.size() ? document_texts_[ordinal] : string_view{};
 }
-std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, const string_view raw_query, int document_id) const {
-    Query query = ParseQuery(raw_query);
-    set<string_view> BingoWords = {}; //Чтобы не сортировать и не проверять на совпадение
 
-    //Обработка вектора плюс-слов
-    for (const auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)) {
-            BingoWords.insert(word);
+//Пакетный поиск
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& queries) const {
+    return FindTopDocumentsBatch(execution::par, queries);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const execution::sequenced_policy&, const vector<string>& queries) const {
+    return FindTopDocumentsBatchImpl(execution::seq, queries.begin(), queries.end());
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const execution::parallel_policy&, const vector<string>& queries) const {
+    return FindTopDocumentsBatchImpl(execution::par, queries.begin(), queries.end());
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(QueryIterator first, QueryIterator last) const {
+    return FindTopDocumentsBatch(execution::par, first, last);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const execution::sequenced_policy&, QueryIterator first, QueryIterator last) const {
+    return FindTopDocumentsBatchImpl(execution::seq, first, last);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const execution::parallel_policy&, QueryIterator first, QueryIterator last) const {
+    return FindTopDocumentsBatchImpl(execution::par, first, last);
+}
+
+template <typename ExecutionPolicy>
+vector<vector<Document>> SearchServer::FindTopDocumentsBatchImpl(ExecutionPolicy&& policy, QueryIterator first, QueryIterator last) const {
+    const auto query_count = static_cast<size_t>(last - first);
+    vector<vector<Document>> results(query_count);
+    vector<size_t> indexes(query_count);
+    iota(indexes.begin(), indexes.end(), 0);
+    shared_lock lock(index_mutex_);
+
+    //Исключение из параллельного алгоритма завершило бы программу, поэтому ошибки разбора собираются
+    //и первая из них бросается после разбора всего пакета
+    vector<Query> queries(query_count);
+    vector<exception_ptr> errors(query_count);
+    for_each(policy, indexes.begin(), indexes.end(), [&](size_t i) {
+        try {
+            ParseQuery(first[i], queries[i]);
+        }
+        catch (...) {
+            errors[i] = current_exception();
+        }
+        });
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            rethrow_exception(error);
         }
     }
 
+    //Запросы без плюс-слов ничего не находят. Остальные упорядочиваются по самому частому слову (его список
+    //обходить дороже всего), затем по остальным плюс-словам: запросы с общими дорогими словами попадают
+    //в одну группу. Групп не меньше числа ядер, если запросов хватает
+    indexes.erase(remove_if(indexes.begin(), indexes.end(), [&](size_t i) {
+        return queries[i].plus_words.empty();
+        }), indexes.end());
+    vector<TermId> heaviest_terms(queries.size());
+    for (const size_t i : indexes) {
+        heaviest_terms[i] = *max_element(queries[i].plus_words.begin(), queries[i].plus_words.end(), [&](TermId lhs, TermId rhs) {
+            return document_freqs_[lhs] < document_freqs_[rhs];
+            });
+    }
+    sort(indexes.begin(), indexes.end(), [&](size_t lhs, size_t rhs) {
+        return tie(heaviest_terms[lhs], queries[lhs].plus_words) < tie(heaviest_terms[rhs], queries[rhs].plus_words);
+        });
+    static const size_t core_count = max<size_t>(1, thread::hardware_concurrency());
+    const size_t group_size = clamp<size_t>((indexes.size() + core_count - 1) / core_count, 1, MAX_QUERY_GROUP_SIZE);
+    vector<vector<size_t>> groups;
+    for (size_t first = 0; first < indexes.size(); first += group_size) {
+        groups.emplace_back(indexes.begin() + first, indexes.begin() + min(first + group_size, indexes.size()));
+    }
+    for_each(policy, groups.begin(), groups.end(), [&](const vector<size_t>& group) {
+        FindQueryGroupTopDocuments(queries, group, results);
+        });
+    return results;
+}
+
+//Каждое слово, общее для нескольких запросов группы, распаковывается один раз в буфер "номер документа - вклад"
+//с уже отброшенными удаленными и неактуальными документами; запросы затем по очереди складывают в накопителе потока
+//буферы своих слов, а слова, нужные одному запросу, обходят сразу в накопитель, как FindTopDocuments.
+//Слова запроса складываются по возрастанию TermId, поэтому релевантность совпадает с FindTopDocuments до бита.
+//Если буферы группы не помещаются в QUERY_GROUP_POSTING_LIMIT словопозиций, номера документов обходятся диапазонами
+void SearchServer::FindQueryGroupTopDocuments(const vector<Query>& queries, const vector<size_t>& query_indexes,
+    vector<vector<Document>>& results) const {
+    //Общие слова группы по возрастанию
+    vector<TermId> plus_terms;
+    vector<TermId> minus_terms;
+    for (const size_t index : query_indexes) {
+        for (const TermId term_id : queries[index].plus_words) {
+            if (document_freqs_[term_id] != 0) {
+                plus_terms.push_back(term_id);
+            }
+        }
+        minus_terms.insert(minus_terms.end(), queries[index].minus_words.begin(), queries[index].minus_words.end());
+    }
+    size_t posting_count = 0;
+    for (auto* term_ids : { &plus_terms, &minus_terms }) {
+        sort(term_ids->begin(), term_ids->end());
+        auto kept = term_ids->begin();
+        for (auto it = term_ids->begin(); it != term_ids->end();) {
+            const auto next = upper_bound(it, term_ids->end(), *it);
+            if (next - it > 1) {
+                posting_count += document_freqs_[*it];
+                *kept++ = *it;
+            }
+            it = next;
+        }
+        term_ids->erase(kept, term_ids->end());
+    }
+    const size_t document_count = documents_.size();
+    const size_t range_count = max<size_t>(1, (posting_count + QUERY_GROUP_POSTING_LIMIT - 1) / QUERY_GROUP_POSTING_LIMIT);
+    const size_t range_size = (document_count + range_count - 1) / range_count;
+
+    using Selector = TopKSelector<Document, bool(*)(const Document&, const Document&)>;
+    vector<Selector> selectors(query_indexes.size(), Selector(static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT), IsMoreRelevant));
+    //Распакованные общие слова: словопозиции слова k - [offsets[k], offsets[k + 1]) в ordinals и relevances
+    vector<DocumentOrdinal> ordinals;
+    vector<double> relevances;
+    vector<size_t> plus_offsets;
+    vector<size_t> minus_offsets;
+    const auto for_each_posting = [&](TermId term_id, DocumentOrdinal first, DocumentOrdinal last, auto visit) {
+        ForEachSegment([&](const IndexSegment& segment) {
+            if (segment.GetEndOrdinal() <= first || segment.GetFirstOrdinal() >= last) {
+                return;
+            }
+            if (const PostingList* postings = segment.Find(term_id)) {
+                postings->ForEachInRange(first, last, visit);
+            }
+            });
+    };
+    //Вклады неудаленных актуальных документов: visit(ordinal, relevance)
+    const auto for_each_contribution = [&](TermId term_id, DocumentOrdinal first, DocumentOrdinal last, auto visit) {
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+        for_each_posting(term_id, first, last, [&](DocumentOrdinal ordinal, uint32_t count) {
+            const DocumentData& data = documents_[ordinal];
+            if (!data.is_removed && data.status == DocumentStatus::ACTUAL) {
+                visit(ordinal, count * data.inv_word_count * inverse_document_freq);
+            }
+            });
+    };
+    //Позиция общего слова в term_ids; term_ids.size(), если слово нужно одному запросу
+    const auto find_term = [](const vector<TermId>& term_ids, TermId term_id) {
+        const auto it = lower_bound(term_ids.begin(), term_ids.end(), term_id);
+        return static_cast<size_t>((it != term_ids.end() && *it == term_id ? it : term_ids.end()) - term_ids.begin());
+    };
+
+    for (size_t range_first = 0; range_first < document_count; range_first += range_size) {
+        const auto first = static_cast<DocumentOrdinal>(range_first);
+        const auto last = static_cast<DocumentOrdinal>(min(range_first + range_size, document_count));
+        ordinals.clear();
+        relevances.clear();
+        plus_offsets.assign(1, 0);
+        for (const TermId term_id : plus_terms) {
+            for_each_contribution(term_id, first, last, [&](DocumentOrdinal ordinal, double relevance) {
+                ordinals.push_back(ordinal);
+                relevances.push_back(relevance);
+                });
+            plus_offsets.push_back(ordinals.size());
+        }
+        minus_offsets.assign(1, ordinals.size());
+        for (const TermId term_id : minus_terms) {
+            for_each_posting(term_id, first, last, [&](DocumentOrdinal ordinal, uint32_t) {
+                ordinals.push_back(ordinal);
+                });
+            minus_offsets.push_back(ordinals.size());
+        }
+
+        RelevanceAccumulator& document_to_relevance = GetThreadAccumulator();
+        for (size_t query = 0; query < query_indexes.size(); ++query) {
+            const Query& words = queries[query_indexes[query]];
+            document_to_relevance.Reset(last - first, first);
+            for (const TermId term_id : words.plus_words) {
+                if (document_freqs_[term_id] == 0) {
+                    continue;
+                }
+                const size_t term = find_term(plus_terms, term_id);
+                if (term == plus_terms.size()) {
+                    for_each_contribution(term_id, first, last, [&](DocumentOrdinal ordinal, double relevance) {
+                        document_to_relevance.Add(ordinal, relevance);
+                        });
+                    continue;
+                }
+                for (size_t i = plus_offsets[term]; i < plus_offsets[term + 1]; ++i) {
+                    document_to_relevance.Add(ordinals[i], relevances[i]);
+                }
+            }
+            for (const TermId term_id : words.minus_words) {
+                const size_t term = find_term(minus_terms, term_id);
+                if (term == minus_terms.size()) {
+                    for_each_posting(term_id, first, last, [&](DocumentOrdinal ordinal, uint32_t) {
+                        document_to_relevance.Exclude(ordinal);
+                        });
+                    continue;
+                }
+                for (size_t i = minus_offsets[term]; i < minus_offsets[term + 1]; ++i) {
+                    document_to_relevance.Exclude(ordinals[i]);
+                }
+            }
+            document_to_relevance.ForEach([&](DocumentOrdinal ordinal, double relevance) {
+                selectors[query].Add({ documents_[ordinal].id, relevance, documents_[ordinal].rating });
+                });
+        }
+    }
+    for (size_t query = 0; query < query_indexes.size(); ++query) {
+        results[query_indexes[query]] = selectors[query].Extract();
+    }
+}
+
+//Метод возврата списка совпавших слов запроса
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query, int document_id) const {
+    shared_lock lock(index_mutex_);
+    const Query& query = ParseQuery(raw_query);
+    const auto ordinal = GetDocumentOrdinal(document_id);
+    const DocumentStatus status = documents_[ordinal].status;
+    //Все словопозиции документа лежат в одном сегменте
+    const IndexSegment& segment = GetSegment(ordinal);
+    const auto contains = [&segment, ordinal](TermId term_id) {
+        const PostingList* postings = segment.Find(term_id);
+        return postings != nullptr && postings->Contains(ordinal);
+    };
+
     //Исключение документов с минус-словами
-    for (const auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)) {
-            BingoWords.clear();
+    for (const TermId term_id : query.minus_words) {
+        if (contains(term_id)) {
+            return tuple(vector<string_view>{}, status);
         }
     }
-    vector<string_view> v(BingoWords.begin(), BingoWords.end());
-    return tuple(v, documents_.at(document_id).status);
+
+    //Обработка вектора плюс-слов; слова берутся из словаря, а не из текста запроса
+    vector<string_view> matched_words;
+    for (const TermId term_id : query.plus_words) {
+        if (contains(term_id)) {
+            matched_words.push_back(terms_.GetTerm(term_id));
+        }
+    }
+    sort(matched_words.begin(), matched_words.end());
+    return tuple(matched_words, status);
+}
+
+
+std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, const string_view raw_query, int document_id) const {
+    return SearchServer::MatchDocument(raw_query, document_id);
+}
+//Проверка слов запроса - бинарные поиски по спискам словопозиций, распараллеливать их невыгодно
+std::tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, const string_view raw_query, int document_id) const {
+    return SearchServer::MatchDocument(raw_query, document_id);
 }
 //Проверка входящего слова на принадлежность к стоп-словам
 bool SearchServer::IsStopWord(const string_view word) const {
     return stop_words_.count(word) > 0;
 }
 
-//Разбивка строки запроса на вектор слов, исключая стоп-слова
-vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
-    vector<string_view> words;
-    for (const auto word : SplitIntoWords(text)) {
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
-    }
-    return words;
-}
-
 //Метод подсчета среднего рейтинга
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     if (ratings.empty()) {
@@ -112,61 +607,120 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-//Отсечение "-" у минус-слов
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
-    bool is_minus = false;
-    if (text[0] == '-') {
-        is_minus = true;
-        text.remove_prefix(1);
+//Разбор запроса в query за один проход: проверка символов и разбиение на слова выполняются вместе.
+//Ошибки запоминаются и проверяются после прохода в прежнем порядке, поэтому текст исключения не зависит от их позиций
+void SearchServer::ParseQuery(const string_view raw_query, Query& query) const {
+    query.plus_words.clear();
+    query.minus_words.clear();
+    bool has_special_symbols = false;
+    bool has_double_minus = false;
+    bool has_minus_without_word = false;
+    size_t word_begin = 0;
+    char previous = ' ';
+    for (size_t i = 0; i < raw_query.size(); ++i) {
+        const char c = raw_query[i];
+        if (c == ' ') {
+            has_minus_without_word |= previous == '-';
+            if (word_begin < i) {
+                AddQueryWord(raw_query.substr(word_begin, i - word_begin), query);
+            }
+            word_begin = i + 1;
+        }
+        else {
+            has_special_symbols |= c >= '\0' && c < ' ';
+            has_double_minus |= c == '-' && previous == '-';
+        }
+        previous = c;
+    }
+    has_minus_without_word |= previous == '-';
+    if (word_begin < raw_query.size()) {
+        AddQueryWord(raw_query.substr(word_begin), query);
     }
-    return {
-        text,
-        is_minus,
-        IsStopWord(text)
-    };
-}
 
-//Создание списков плюс- и минус-слов
-SearchServer::Query SearchServer::ParseQuery(const string_view raw_query) const {
-    if (!IsValidWord(raw_query)) {
+    if (has_special_symbols) {
         throw invalid_argument("Query contains special symbols"s);
     }
-    else if (raw_query.find("--"s) != string::npos) {
+    else if (has_double_minus) {
         throw invalid_argument("Query contains double-minus"s);
     }
-    else if (raw_query.find("- "s) != string::npos) {
+    else if (has_minus_without_word) {
         throw invalid_argument("No word after '-' symbol"s);
     }
-    else if (raw_query[size(raw_query) - 1] == '-') {
-        throw invalid_argument("No word after '-' symbol"s);
+    for (auto* term_ids : { &query.plus_words, &query.minus_words }) {
+        sort(term_ids->begin(), term_ids->end());
+        term_ids->erase(unique(term_ids->begin(), term_ids->end()), term_ids->end());
     }
-    Query query;
-    for (const auto word : SplitIntoWords(raw_query)) {
-        const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.insert(query_word.data);
-            }
-            else {
-                query.plus_words.insert(query_word.data);
-            }
-        }
+}
+
+//Разбор запроса в запрос текущего потока; ссылка действительна до следующего разбора в этом потоке
+const SearchServer::Query& SearchServer::ParseQuery(const string_view raw_query) const {
+    Query& query = GetThreadQuery();
+    ParseQuery(raw_query, query);
+    return query;
+}
+
+//Отсечение "-" у минус-слова и добавление его TermId в query (стоп-слова и неизвестные слова пропускаются)
+void SearchServer::AddQueryWord(string_view word, Query& query) const {
+    bool is_minus = false;
+    if (word[0] == '-') {
+        is_minus = true;
+        word.remove_prefix(1);
+    }
+    if (word.empty() || IsStopWord(word)) {
+        return;
+    }
+    //Слово, которого нет в словаре, не влияет на выдачу
+    const TermId term_id = terms_.Find(word);
+    if (term_id == TermDictionary::NO_TERM) {
+        return;
     }
+    if (is_minus) {
+        query.minus_words.push_back(term_id);
+    }
+    else {
+        query.plus_words.push_back(term_id);
+    }
+}
+
+//Запрос текущего потока (свой у каждого потока, переиспользуется между запросами)
+SearchServer::Query& SearchServer::GetThreadQuery() {
+    static thread_local Query query;
     return query;
 }
 
-//Вычисление IDF слова
-double SearchServer::ComputeWordInverseDocumentFreq(const string_view word) const {
-    return log(documents_.size() * 1.0 / word_to_document_freqs_.at(word).size());
+//Накопитель релевантности текущего потока (свой у каждого потока, переиспользуется между запросами)
+RelevanceAccumulator& SearchServer::GetThreadAccumulator() {
+    static thread_local RelevanceAccumulator accumulator;
+    return accumulator;
+}
+
+//Число частей диапазона номеров документов для параллельного поиска (не больше числа ядер)
+size_t SearchServer::GetScoringPartCount(size_t document_count) {
+    static const size_t core_count = max<size_t>(1, thread::hardware_concurrency());
+    //Слишком маленькие части не окупают запуск задачи
+    const size_t min_part_size = 1024;
+    return max<size_t>(1, min(core_count, document_count / min_part_size));
+}
+
+//Число частей пакета для параллельного добавления (не больше числа ядер)
+size_t SearchServer::GetIndexingPartCount(size_t document_count) {
+    static const size_t core_count = max<size_t>(1, thread::hardware_concurrency());
+    //Разбиение документа на слова дороже обработки словопозиции, поэтому части меньше, чем при поиске
+    const size_t min_part_size = 64;
+    return max<size_t>(1, min(core_count, document_count / min_part_size));
+}
+
+//Пересчет логарифма df слова после изменения его списка словопозиций
+void SearchServer::UpdateDocumentFreq(TermId term_id) {
+    const size_t document_freq = document_freqs_[term_id];
+    log_document_freqs_[term_id] = document_freq == 0 ? 0.0 : log(static_cast<double>(document_freq));
 }
 
 
 bool SearchServer::IsValidWord(const string_view word) {
     // A valid word must not contain special characters
     // Возвращает true, если в слове отсутствуют спецсимволы
-    return none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-        });
+    return !HasSpecialSymbols(word);
 }
 
 void PrintDocument(const Document& document) {
@@ -222,42 +776,799 @@ void MatchDocuments(const SearchServer& search_server, const string_view query)
     }
 }
 
-//Метод получения частот слов по id документа
-
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const map<string_view, double> empty_words = {};
+//Метод получения частот слов по id документа (словарь собирается из индекса по запросу)
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    shared_lock lock(index_mutex_);
+    map<string_view, double> word_freqs;
+    const auto it = document_ordinals_.find(document_id);
+    if (it != document_ordinals_.end()) {
+        for (const auto [term_id, term_freq] : document_to_word_freqs_[it->second]) {
+            word_freqs.emplace(terms_.GetTerm(term_id), term_freq);
+        }
+    }
+    return word_freqs;
+}//WlogW
 
-    if (document_to_word_freqs_.count(document_id)) {
-        return document_to_word_freqs_.at(document_id);
-    }//logN
-    else {
-        return empty_words;
-    }      
-}//logN
+//Id дубликатов по возрастанию: документов, множество слов которых совпадает с документом с меньшим id
+vector<int> SearchServer::FindDuplicates() const {
+    shared_lock lock(index_mutex_);
+    vector<int> duplicates;
+    //Запоминаются только отпечатки, встречающиеся больше одного раза
+    unordered_set<DocumentFingerprint, DocumentFingerprintHasher> seen;
+    for (const int document_id : document_ids_) {
+        const DocumentFingerprint& fingerprint = document_fingerprints_[document_ordinals_.at(document_id)];
+        if (fingerprint_counts_.at(fingerprint) > 1 && !seen.insert(fingerprint).second) {
+            duplicates.push_back(document_id);
+        }
+    }
+    return duplicates;
+}
 
 //Метод удаления документов из поискового сервера
 void SearchServer::RemoveDocument(int document_id) {
-    for (auto [word, freq] : document_to_word_freqs_.at(document_id)) {
-        word_to_document_freqs_.at(word).erase(document_id);
-    }//WlogN + 1 = WlogN
-    document_to_word_freqs_.erase(document_id);//logN + 1 = logN
-    document_ids_.erase(document_id);//logN + 1
-    documents_.erase(document_id);//logN + 1
+    RemoveDocument(execution::seq, document_id);
 }//WlogN
 
 
+//Документ помечается удаленным, его словопозиции остаются в списках до сжатия индекса, поиск их пропускает.
+//Меняются только счетчики df слов документа
 void SearchServer::RemoveDocument(const execution::sequenced_policy&, int document_id) {
-    for_each(execution::seq, document_to_word_freqs_.at(document_id).begin(), document_to_word_freqs_.at(document_id).end(),
-        [&, document_id](auto& el) { word_to_document_freqs_.at(el.first).erase(document_id); });
-    document_to_word_freqs_.erase(document_id);//logN + 1 = logN
-    document_ids_.erase(document_id);//logN + 1
-    documents_.erase(document_id);//logN + 1
+    unique_lock write_lock(write_mutex_);
+    {
+        unique_lock index_lock(index_mutex_);
+        const auto ordinal = GetDocumentOrdinal(document_id);
+        const auto& word_freqs = document_to_word_freqs_[ordinal];
+        for (const auto [term_id, term_freq] : word_freqs) {
+            --document_freqs_[term_id];
+            UpdateDocumentFreq(term_id);
+        }//W
+        removed_posting_count_ += word_freqs.size();
+        ordinals_to_compact_.push_back(ordinal);
+        documents_[ordinal].is_removed = true;
+        EraseDocumentData(document_id, ordinal);
+    }
+    //Сжатие пакетом, когда удаленные словопозиции составляют половину индекса: его стоимость делится между удалениями
+    if (removed_posting_count_ * 2 > posting_count_) {
+        CompactSegments(execution::seq);
+    }
+    const LogTicket ticket = LogMutation(MutationType::REMOVE_DOCUMENTS, [&](MutationEncoder& body) {
+        body.Put<uint32_t>(1);
+        body.Put<int32_t>(document_id);
+        });
+    write_lock.unlock();
+    ticket.Wait();
 }
+//Удаление не трогает списки словопозиций, распараллеливать в нем нечего
 void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
-    for_each(execution::par, document_to_word_freqs_.at(document_id).begin(), document_to_word_freqs_.at(document_id).end(),
-        [&, document_id](auto& el) { word_to_document_freqs_.at(el.first).erase(document_id); });
-    document_to_word_freqs_.erase(document_id);//logN + 1 = logN
+    RemoveDocument(execution::seq, document_id);
+}
+
+//Пакетное удаление документов
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocuments(execution::par, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const execution::sequenced_policy&, const vector<int>& document_ids) {
+    RemoveDocumentsBatch(execution::seq, document_ids, true);
+}
+
+void SearchServer::RemoveDocuments(const execution::parallel_policy&, const vector<int>& document_ids) {
+    RemoveDocumentsBatch(execution::par, document_ids, true);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocumentsBatch(ExecutionPolicy&& policy, const vector<int>& document_ids, bool allow_compaction) {
+    //Другие записи исключены, поэтому чтение индекса до монопольной блокировки безопасно.
+    //Все id проверяются до изменения индекса
+    unique_lock write_lock(write_mutex_);
+    vector<DocumentOrdinal> ordinals;
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        ordinals.push_back(GetDocumentOrdinal(document_id));
+    }
+    sort(ordinals.begin(), ordinals.end());
+    ordinals.erase(unique(ordinals.begin(), ordinals.end()), ordinals.end());
+
+    //Слова удаляемых документов раскладываются по группам слов: part_terms[часть][группа]
+    const size_t part_count = GetIndexingPartCount(ordinals.size());
+    vector<size_t> parts(part_count);
+    iota(parts.begin(), parts.end(), 0);
+    vector<vector<vector<TermId>>> part_terms(part_count, vector<vector<TermId>>(part_count));
+    for_each(policy, parts.begin(), parts.end(), [&](size_t part) {
+        const size_t first = ordinals.size() * part / part_count;
+        const size_t last = ordinals.size() * (part + 1) / part_count;
+        for (size_t i = first; i < last; ++i) {
+            for (const auto [term_id, term_freq] : document_to_word_freqs_[ordinals[i]]) {
+                part_terms[part][term_id % part_count].push_back(term_id);
+            }
+        }
+        });
+
+    //df слова меняет только поток его группы
+    unique_lock index_lock(index_mutex_);
+    for_each(policy, parts.begin(), parts.end(), [&](size_t shard) {
+        vector<TermId> touched_terms;
+        for (const auto& terms : part_terms) {
+            for (const TermId term_id : terms[shard]) {
+                --document_freqs_[term_id];
+            }
+            touched_terms.insert(touched_terms.end(), terms[shard].begin(), terms[shard].end());
+        }
+        sort(touched_terms.begin(), touched_terms.end());
+        touched_terms.erase(unique(touched_terms.begin(), touched_terms.end()), touched_terms.end());
+        for (const TermId term_id : touched_terms) {
+            UpdateDocumentFreq(term_id);
+        }
+        });
+
+    for (const DocumentOrdinal ordinal : ordinals) {
+        removed_posting_count_ += document_to_word_freqs_[ordinal].size();
+        documents_[ordinal].is_removed = true;
+        EraseDocumentData(documents_[ordinal].id, ordinal);
+    }
+    index_lock.unlock();
+    ordinals_to_compact_.insert(ordinals_to_compact_.end(), ordinals.begin(), ordinals.end());
+    //Как и при одиночном удалении, сегменты перестраиваются пакетом, когда удаленные словопозиции составляют
+    //половину индекса; до того их убирают фоновые слияния и CompactIndex
+    if (allow_compaction && removed_posting_count_ * 2 > posting_count_) {
+        CompactSegments(policy);
+    }
+    const LogTicket ticket = LogMutation(MutationType::REMOVE_DOCUMENTS, [&](MutationEncoder& body) {
+        body.Put<uint32_t>(static_cast<uint32_t>(document_ids.size()));
+        for (const int document_id : document_ids) {
+            body.Put<int32_t>(document_id);
+        }
+        });
+    write_lock.unlock();
+    ticket.Wait();
+}
+
+//Сжатие индекса: физическое удаление словопозиций удаленных документов
+void SearchServer::CompactIndex() {
+    CompactIndex(execution::par);
+}
+
+void SearchServer::CompactIndex(const execution::sequenced_policy&) {
+    lock_guard write_lock(write_mutex_);
+    CompactSegments(execution::seq);
+}
+
+void SearchServer::CompactIndex(const execution::parallel_policy&) {
+    lock_guard write_lock(write_mutex_);
+    CompactSegments(execution::par);
+}
+
+//Сжатие индекса в отдельном потоке; запросы ждут только замены перестроенных сегментов
+future<void> SearchServer::CompactIndexAsync() {
+    return async(launch::async, [this] {
+        CompactIndex(execution::par);
+        });
+}
+
+//Каждый затронутый сегмент перестраивается один раз. Новые сегменты строятся рядом со старыми
+//без монопольной блокировки: другие записи исключены write_mutex_, а запросы только читают.
+//Монопольно выполняется лишь замена сегментов; открытый сегмент после перестроения становится замороженным
+template <typename ExecutionPolicy>
+void SearchServer::CompactSegments(ExecutionPolicy&& policy) {
+    //Номера не переиспользуются, поэтому удаленные документы копятся в массивах по номеру и в снимках;
+    //когда они занимают больше половины номеров, их место освобождает перенумерация
+    if ((documents_.size() - document_ordinals_.size()) * 2 > documents_.size()) {
+        RenumberDocuments(policy);
+        return;
+    }
+    //Номера сегментов с удаленными документами; frozen_segments_.size() обозначает открытый сегмент
+    sort(ordinals_to_compact_.begin(), ordinals_to_compact_.end());
+    vector<size_t> targets;
+    for (const DocumentOrdinal ordinal : ordinals_to_compact_) {
+        const size_t target = ordinal >= open_segment_.GetFirstOrdinal() ? frozen_segments_.size()
+            : partition_point(frozen_segments_.begin(), frozen_segments_.end(), [ordinal](const auto& segment) {
+                return segment->GetEndOrdinal() <= ordinal;
+                }) - frozen_segments_.begin();
+        if (targets.empty() || targets.back() != target) {
+            targets.push_back(target);
+        }
+    }
+
+    vector<shared_ptr<const IndexSegment>> compacted(targets.size());
+    transform(policy, targets.begin(), targets.end(), compacted.begin(), [&](size_t target) {
+        const IndexSegment& source = target < frozen_segments_.size() ? *frozen_segments_[target] : open_segment_;
+        return make_shared<const IndexSegment>(IndexSegment::Merge(policy, { &source }, [this](DocumentOrdinal ordinal) {
+            return documents_[ordinal].is_removed;
+            }));
+        });
+    size_t purged_count = 0;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        const IndexSegment& source = targets[i] < frozen_segments_.size() ? *frozen_segments_[targets[i]] : open_segment_;
+        purged_count += source.GetPostingCount() - compacted[i]->GetPostingCount();
+    }
+
+    //Старые сегменты освобождаются после снятия блокировки
+    vector<shared_ptr<const IndexSegment>> replaced;
+    const bool open_compacted = !targets.empty() && targets.back() == frozen_segments_.size();
+    {
+        unique_lock index_lock(index_mutex_);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (targets[i] < frozen_segments_.size()) {
+                replaced.push_back(move(frozen_segments_[targets[i]]));
+                frozen_segments_[targets[i]] = move(compacted[i]);
+            }
+            else {
+                frozen_segments_.push_back(move(compacted[i]));
+                open_segment_ = IndexSegment(static_cast<DocumentOrdinal>(documents_.size()));
+            }
+        }
+    }
+    vector<DocumentOrdinal>().swap(ordinals_to_compact_);
+    posting_count_ -= purged_count;
+    removed_posting_count_ -= purged_count;
+    if (open_compacted) {
+        ScheduleMerges();
+    }
+}
+
+//Документы сохраняют порядок, поэтому списки словопозиций с новыми номерами строятся тем же слиянием.
+//Как и в CompactSegments, новые массивы строятся рядом со старыми и подменяются монопольно.
+//Идущее фоновое слияние отбросит свой результат: все его исходные сегменты заменены
+template <typename ExecutionPolicy>
+void SearchServer::RenumberDocuments(ExecutionPolicy&& policy) {
+    const size_t document_count = document_ordinals_.size();
+    vector<DocumentOrdinal> new_ordinals(documents_.size(), IndexSegment::REMOVED_ORDINAL);
+    vector<DocumentData> documents;
+    documents.reserve(document_count);
+    vector<DocumentFingerprint> document_fingerprints;
+    document_fingerprints.reserve(document_count);
+    vector<string_view> document_texts;
+    unordered_map<int, DocumentOrdinal> document_ordinals;
+    document_ordinals.reserve(document_count);
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        if (documents_[ordinal].is_removed) {
+            continue;
+        }
+        const auto new_ordinal = static_cast<DocumentOrdinal>(documents.size());
+        new_ordinals[ordinal] = new_ordinal;
+        documents.push_back(documents_[ordinal]);
+        document_fingerprints.push_back(document_fingerprints_[ordinal]);
+        if (ordinal < document_texts_.size()) {
+            document_texts.resize(new_ordinal + 1u);
+            document_texts[new_ordinal] = document_texts_[ordinal];
+        }
+        document_ordinals.emplace(documents_[ordinal].id, new_ordinal);
+    }
+
+    vector<const IndexSegment*> segments;
+    for (const auto& segment : frozen_segments_) {
+        segments.push_back(segment.get());
+    }
+    segments.push_back(&open_segment_);
+    const auto end_ordinal = static_cast<DocumentOrdinal>(document_count);
+    auto renumbered = make_shared<const IndexSegment>(IndexSegment::Renumber(policy, segments, 0, end_ordinal,
+        [&new_ordinals](DocumentOrdinal ordinal) {
+            return new_ordinals[ordinal];
+        }));
+    vector<vector<TermFrequency>> word_freqs(document_count);
+
+    //Старые сегменты и массивы освобождаются после снятия блокировки
+    vector<shared_ptr<const IndexSegment>> replaced;
+    IndexSegment replaced_open_segment;
+    {
+        unique_lock index_lock(index_mutex_);
+        replaced.swap(frozen_segments_);
+        if (document_count > 0) {
+            frozen_segments_.push_back(renumbered);
+        }
+        replaced_open_segment = move(open_segment_);
+        open_segment_ = IndexSegment(end_ordinal);
+        for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+            if (new_ordinals[ordinal] != IndexSegment::REMOVED_ORDINAL) {
+                word_freqs[new_ordinals[ordinal]] = move(document_to_word_freqs_[ordinal]);
+            }
+        }
+        document_to_word_freqs_.swap(word_freqs);
+        documents_.swap(documents);
+        document_fingerprints_.swap(document_fingerprints);
+        document_texts_.swap(document_texts);
+        document_ordinals_.swap(document_ordinals);
+    }
+    vector<DocumentOrdinal>().swap(ordinals_to_compact_);
+    posting_count_ = renumbered->GetPostingCount();
+    removed_posting_count_ = 0;
+}
+
+//Уничтожение дожидается фоновых слияний сегментов
+SearchServer::~SearchServer() {
+    WaitForMerges();
+}
+
+//Параметры сегментов; действуют на следующие заморозки и слияния
+void SearchServer::SetSegmentOptions(const SegmentOptions& options) {
+    lock_guard write_lock(write_mutex_);
+    segment_options_.document_limit = max<size_t>(1, options.document_limit);
+    segment_options_.merge_factor = max<size_t>(2, options.merge_factor);
+}
+
+//Число сегментов индекса, включая открытый, если в нем есть документы
+size_t SearchServer::GetSegmentCount() const {
+    shared_lock lock(index_mutex_);
+    return frozen_segments_.size() + (open_segment_.GetEndOrdinal() > open_segment_.GetFirstOrdinal() ? 1 : 0);
+}
+
+//Ожидание окончания фоновых слияний сегментов
+void SearchServer::WaitForMerges() {
+    while (true) {
+        shared_future<void> merge;
+        {
+            lock_guard write_lock(write_mutex_);
+            if (!merge_running_) {
+                return;
+            }
+            merge = merge_future_;
+        }
+        merge.wait();
+    }
+}
+
+//Заморозка открытого сегмента, если в нем segment_options_.document_limit документов
+void SearchServer::FreezeFullOpenSegment() {
+    const DocumentOrdinal end_ordinal = open_segment_.GetEndOrdinal();
+    if (end_ordinal - open_segment_.GetFirstOrdinal() < segment_options_.document_limit) {
+        return;
+    }
+    open_segment_.Freeze();
+    frozen_segments_.push_back(make_shared<const IndexSegment>(move(open_segment_)));
+    open_segment_ = IndexSegment(end_ordinal);
+    ScheduleMerges();
+}
+
+//Запуск фонового слияния, если оно еще не идет
+void SearchServer::ScheduleMerges() {
+    if (merge_running_ || SelectMergeRange() == frozen_segments_.size()) {
+        return;
+    }
+    merge_running_ = true;
+    merge_future_ = async(launch::async, [this] {
+        RunMerges();
+        }).share();
+}
+
+//Фоновое слияние: пока есть сегменты для слияния, они сливаются без блокировок и заменяются монопольно.
+//Удаленность документов снимается до слияния: документы, удаленные во время него, останутся в новом сегменте
+//помеченными и будут убраны следующим слиянием или сжатием
+void SearchServer::RunMerges() {
+    while (true) {
+        vector<shared_ptr<const IndexSegment>> sources;
+        vector<char> removed;
+        {
+            lock_guard write_lock(write_mutex_);
+            const size_t first = SelectMergeRange();
+            if (first == frozen_segments_.size()) {
+                merge_running_ = false;
+                return;
+            }
+            sources.assign(frozen_segments_.begin() + first, frozen_segments_.begin() + first + segment_options_.merge_factor);
+            for (DocumentOrdinal ordinal = sources.front()->GetFirstOrdinal(); ordinal < sources.back()->GetEndOrdinal(); ++ordinal) {
+                removed.push_back(documents_[ordinal].is_removed);
+            }
+        }
+
+        const DocumentOrdinal first_ordinal = sources.front()->GetFirstOrdinal();
+        vector<const IndexSegment*> segments;
+        size_t source_posting_count = 0;
+        for (const auto& segment : sources) {
+            segments.push_back(segment.get());
+            source_posting_count += segment->GetPostingCount();
+        }
+        auto merged = make_shared<const IndexSegment>(IndexSegment::Merge(execution::par, segments, [&](DocumentOrdinal ordinal) {
+            return removed[ordinal - first_ordinal] != 0;
+            }));
+        const size_t purged_count = source_posting_count - merged->GetPostingCount();
+
+        lock_guard write_lock(write_mutex_);
+        //Сжатие индекса могло заменить исходные сегменты - тогда результат слияния отбрасывается
+        const auto it = find(frozen_segments_.begin(), frozen_segments_.end(), sources.front());
+        if (static_cast<size_t>(frozen_segments_.end() - it) < sources.size() || !equal(sources.begin(), sources.end(), it)) {
+            continue;
+        }
+        {
+            unique_lock index_lock(index_mutex_);
+            *it = move(merged);
+            frozen_segments_.erase(it + 1, it + sources.size());
+        }
+        posting_count_ -= purged_count;
+        removed_posting_count_ -= purged_count;
+        const DocumentOrdinal end_ordinal = sources.back()->GetEndOrdinal();
+        ordinals_to_compact_.erase(remove_if(ordinals_to_compact_.begin(), ordinals_to_compact_.end(), [&](DocumentOrdinal ordinal) {
+            return ordinal >= first_ordinal && ordinal < end_ordinal && removed[ordinal - first_ordinal];
+            }), ordinals_to_compact_.end());
+    }
+}
+
+//Начало отрезка frozen_segments_ из merge_factor соседних сегментов для слияния.
+//Уровень сегмента растет на единицу с каждым умножением его диапазона номеров на merge_factor.
+//Сегменты делятся на группы от старых к новым: группа заканчивается последним сегментом наибольшего
+//среди оставшихся уровня, поэтому меньшие сегменты внутри группы сливаются вместе с большими
+size_t SearchServer::SelectMergeRange() const {
+    const size_t merge_factor = segment_options_.merge_factor;
+    vector<size_t> levels;
+    levels.reserve(frozen_segments_.size());
+    for (const auto& segment : frozen_segments_) {
+        const size_t span = segment->GetEndOrdinal() - segment->GetFirstOrdinal();
+        size_t level = 0;
+        for (size_t level_span = segment_options_.document_limit * merge_factor; span >= level_span; level_span *= merge_factor) {
+            ++level;
+        }
+        levels.push_back(level);
+    }
+    for (size_t start = 0; start < levels.size();) {
+        const size_t max_level = *max_element(levels.begin() + start, levels.end());
+        size_t end = levels.size();
+        while (levels[end - 1] != max_level) {
+            --end;
+        }
+        if (end - start >= merge_factor) {
+            return start;
+        }
+        start = end;
+    }
+    return frozen_segments_.size();
+}
+
+//Сегмент, в диапазон которого попадает номер документа
+const IndexSegment& SearchServer::GetSegment(DocumentOrdinal ordinal) const {
+    if (ordinal >= open_segment_.GetFirstOrdinal()) {
+        return open_segment_;
+    }
+    return **partition_point(frozen_segments_.begin(), frozen_segments_.end(), [ordinal](const auto& segment) {
+        return segment->GetEndOrdinal() <= ordinal;
+        });
+}
+
+//Номер документа по id (исключение, если документа нет)
+DocumentOrdinal SearchServer::GetDocumentOrdinal(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        throw out_of_range("Document_id doesn't exist"s);
+    }
+    return it->second;
+}
+
+//Расширение массивов по TermId до размера словаря
+void SearchServer::ResizeTermArrays() {
+    if (document_freqs_.size() == terms_.size()) {
+        return;
+    }
+    document_freqs_.resize(terms_.size());
+    log_document_freqs_.resize(terms_.size());
+    term_fingerprints_.reserve(terms_.size());
+    for (auto term_id = static_cast<TermId>(term_fingerprints_.size()); term_id < terms_.size(); ++term_id) {
+        term_fingerprints_.push_back(ComputeTermFingerprint(terms_.GetTerm(term_id)));
+    }
+}
+
+//Последний номер не выдается: ForEach списков словопозиций обходит номера до него
+void SearchServer::ReserveOrdinals(size_t count) {
+    if (count > numeric_limits<DocumentOrdinal>::max() - documents_.size() && documents_.size() > document_ordinals_.size()) {
+        RenumberDocuments(execution::par);
+    }
+    if (count > numeric_limits<DocumentOrdinal>::max() - documents_.size()) {
+        throw length_error("Document ordinals are exhausted"s);
+    }
+}
+
+//Копирование текста документа в сервер, если хранение текстов включено
+void SearchServer::StoreDocumentText(DocumentOrdinal ordinal, string_view text) {
+    if (!store_document_texts_) {
+        return;
+    }
+    if (document_texts_.size() <= ordinal) {
+        document_texts_.resize(ordinal + 1u);
+    }
+    document_texts_[ordinal] = document_text_storage_.Store(text);
+}
+
+//Удаление данных документа после удаления его словопозиций
+//Номер документа не переиспользуется, его ячейка в documents_ остается без ссылок до перенумерации
+void SearchServer::EraseDocumentData(int document_id, DocumentOrdinal ordinal) {
+    vector<TermFrequency>().swap(document_to_word_freqs_[ordinal]);//1
     document_ids_.erase(document_id);//logN + 1
-    documents_.erase(document_id);//logN + 1
+    document_ordinals_.erase(document_id);//1
+    const auto fingerprint_count = fingerprint_counts_.find(document_fingerprints_[ordinal]);
+    if (--fingerprint_count->second == 0) {
+        fingerprint_counts_.erase(fingerprint_count);
+    }
+    //Текст остается в хранилище до уничтожения сервера, пропадает только ссылка на него
+    if (ordinal < document_texts_.size()) {
+        document_texts_[ordinal] = {};
+    }
+    log_document_count_ = document_ordinals_.empty() ? 0.0 : log(static_cast<double>(document_ordinals_.size()));
+}
+
+//Сохранение индекса в двоичный снимок. Все записи идут под write_mutex_, поэтому индекс
+//не меняется до конца сохранения, а запросы его только читают
+void SearchServer::SaveSnapshot(const string& path) const {
+    lock_guard write_lock(write_mutex_);
+    SaveSnapshotLocked(path);
+}
+
+void SearchServer::SaveSnapshotLocked(const string& path) const {
+    SnapshotWriter writer(path);
+    writer.Write(SNAPSHOT_MAGIC);
+    writer.Write(SNAPSHOT_VERSION);
+    writer.Write(SNAPSHOT_BYTE_ORDER_MARK);
+    writer.WriteStrings(vector<string_view>(stop_words_.begin(), stop_words_.end()));
+    writer.Write<uint8_t>(store_document_texts_);
+    writer.Write<uint64_t>(applied_lsn_);
+
+    //Словарь и массивы по TermId
+    vector<string_view> terms;
+    terms.reserve(terms_.size());
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        terms.push_back(terms_.GetTerm(term_id));
+    }
+    writer.WriteStrings(terms);
+    writer.WriteArray(document_freqs_.data(), document_freqs_.size());
+    writer.WriteArray(log_document_freqs_.data(), log_document_freqs_.size());
+    writer.WriteArray(term_fingerprints_.data(), term_fingerprints_.size());
+    writer.Write(log_document_count_);
+
+    //Массивы по номерам документов; частоты слов документов идут подряд, границы задают смещения
+    vector<SnapshotDocument> documents;
+    documents.reserve(documents_.size());
+    for (const DocumentData& data : documents_) {
+        documents.push_back({ data.id, data.rating, static_cast<uint32_t>(data.status), data.is_removed, data.inv_word_count });
+    }
+    writer.Write<uint64_t>(documents.size());
+    writer.WriteArray(documents.data(), documents.size());
+    writer.WriteArray(document_fingerprints_.data(), document_fingerprints_.size());
+    vector<uint64_t> word_freq_offsets(1, 0);
+    word_freq_offsets.reserve(documents_.size() + 1);
+    for (const auto& word_freqs : document_to_word_freqs_) {
+        word_freq_offsets.push_back(word_freq_offsets.back() + word_freqs.size());
+    }
+    writer.WriteArray(word_freq_offsets.data(), word_freq_offsets.size());
+    vector<SnapshotTermFrequency> word_freqs_buffer;
+    for (const auto& word_freqs : document_to_word_freqs_) {
+        word_freqs_buffer.clear();
+        for (const auto [term_id, term_freq] : word_freqs) {
+            word_freqs_buffer.push_back({ term_id, 0, term_freq });
+        }
+        writer.WriteArray(word_freqs_buffer.data(), word_freqs_buffer.size());
+    }
+    writer.WriteStrings(document_texts_);
+
+    writer.Write<uint64_t>(posting_count_);
+    writer.Write<uint64_t>(removed_posting_count_);
+    writer.Write<uint64_t>(ordinals_to_compact_.size());
+    writer.WriteArray(ordinals_to_compact_.data(), ordinals_to_compact_.size());
+
+    //Открытый сегмент сохраняется, если в нем есть документы, и загружается замороженным
+    const bool save_open_segment = open_segment_.GetEndOrdinal() > open_segment_.GetFirstOrdinal();
+    writer.Write<uint64_t>(frozen_segments_.size() + (save_open_segment ? 1 : 0));
+    for (const auto& segment : frozen_segments_) {
+        segment->Save(writer);
+    }
+    if (save_open_segment) {
+        open_segment_.Save(writer);
+    }
+    writer.Write(SNAPSHOT_MAGIC);
+    writer.Finish();
 }
 
+//Загрузка снимка в пустой сервер. Снимок разбирается в локальные структуры без блокировки индекса,
+//монопольно выполняется только их перемещение в сервер
+void SearchServer::LoadSnapshot(const string& path) {
+    lock_guard write_lock(write_mutex_);
+    if (!documents_.empty()) {
+        throw invalid_argument("Snapshot can be loaded only into an empty server"s);
+    }
+    if (mutation_log_) {
+        throw invalid_argument("Snapshot must be loaded before the mutation log is opened"s);
+    }
+    auto file = make_shared<const MappedFile>(path);
+    SnapshotReader reader(file->data(), file->size());
+    if (file->size() < sizeof(SNAPSHOT_MAGIC) || reader.Read<uint64_t>() != SNAPSHOT_MAGIC) {
+        throw runtime_error("File is not a search server snapshot: "s + path);
+    }
+    const auto version = reader.Read<uint32_t>();
+    if (version < 1 || version > SNAPSHOT_VERSION || reader.Read<uint32_t>() != SNAPSHOT_BYTE_ORDER_MARK) {
+        throw runtime_error("Unsupported snapshot format: "s + path);
+    }
+    set<string, less<>> stop_words;
+    for (const string_view word : reader.ReadStrings()) {
+        stop_words.emplace(word);
+    }
+    const bool store_document_texts = reader.Read<uint8_t>() != 0;
+    //Снимки версии 1 записаны без журнала изменений
+    const uint64_t applied_lsn = version >= 2 ? reader.Read<uint64_t>() : 0;
+
+    //Слова ссылаются на память снимка
+    TermDictionary terms;
+    const vector<string_view> term_views = reader.ReadStrings();
+    for (const string_view term : term_views) {
+        CheckSnapshot(terms.Find(term) == TermDictionary::NO_TERM);
+        terms.AddExternal(term);
+    }
+    const size_t term_count = term_views.size();
+    const uint32_t* document_freqs = reader.ReadArray<uint32_t>(term_count);
+    const double* log_document_freqs = reader.ReadArray<double>(term_count);
+    const DocumentFingerprint* term_fingerprints = reader.ReadArray<DocumentFingerprint>(term_count);
+    const double log_document_count = reader.Read<double>();
+
+    const auto document_count = reader.Read<uint64_t>();
+    CheckSnapshot(document_count <= numeric_limits<DocumentOrdinal>::max());
+    const SnapshotDocument* snapshot_documents = reader.ReadArray<SnapshotDocument>(document_count);
+    const DocumentFingerprint* document_fingerprints = reader.ReadArray<DocumentFingerprint>(document_count);
+    const uint64_t* word_freq_offsets = reader.ReadArray<uint64_t>(document_count + 1);
+    CheckSnapshot(word_freq_offsets[0] == 0);
+    for (size_t i = 0; i < document_count; ++i) {
+        CheckSnapshot(word_freq_offsets[i] <= word_freq_offsets[i + 1]);
+    }
+    const SnapshotTermFrequency* word_freqs = reader.ReadArray<SnapshotTermFrequency>(word_freq_offsets[document_count]);
+
+    vector<DocumentData> documents;
+    documents.reserve(document_count);
+    vector<vector<TermFrequency>> document_to_word_freqs(document_count);
+    unordered_map<int, DocumentOrdinal> document_ordinals;
+    set<int> document_ids;
+    unordered_map<DocumentFingerprint, size_t, DocumentFingerprintHasher> fingerprint_counts;
+    for (DocumentOrdinal ordinal = 0; ordinal < document_count; ++ordinal) {
+        const SnapshotDocument& document = snapshot_documents[ordinal];
+        CheckSnapshot(document.status <= static_cast<uint32_t>(DocumentStatus::REMOVED) && document.is_removed <= 1);
+        documents.push_back({ document.id, document.rating, static_cast<DocumentStatus>(document.status), document.is_removed != 0, document.inv_word_count });
+        auto& document_word_freqs = document_to_word_freqs[ordinal];
+        document_word_freqs.reserve(word_freq_offsets[ordinal + 1] - word_freq_offsets[ordinal]);
+        for (uint64_t i = word_freq_offsets[ordinal]; i < word_freq_offsets[ordinal + 1]; ++i) {
+            CheckSnapshot(word_freqs[i].term_id < term_count);
+            document_word_freqs.push_back({ word_freqs[i].term_id, word_freqs[i].term_freq });
+        }
+        if (!document.is_removed) {
+            CheckSnapshot(document.id >= 0 && document_ordinals.emplace(document.id, ordinal).second);
+            document_ids.insert(document.id);
+            ++fingerprint_counts[document_fingerprints[ordinal]];
+        }
+    }
+    vector<string_view> document_texts = reader.ReadStrings();
+    CheckSnapshot(document_texts.size() <= document_count);
+
+    const auto posting_count = reader.Read<uint64_t>();
+    const auto removed_posting_count = reader.Read<uint64_t>();
+    const auto compact_count = reader.Read<uint64_t>();
+    const DocumentOrdinal* ordinals_to_compact = reader.ReadArray<DocumentOrdinal>(compact_count);
+    for (size_t i = 0; i < compact_count; ++i) {
+        CheckSnapshot(ordinals_to_compact[i] < document_count && documents[ordinals_to_compact[i]].is_removed);
+    }
+
+    //Сегменты должны покрывать номера документов подряд
+    const auto segment_count = reader.Read<uint64_t>();
+    CheckSnapshot(segment_count <= document_count);
+    vector<shared_ptr<const IndexSegment>> frozen_segments;
+    frozen_segments.reserve(segment_count);
+    DocumentOrdinal end_ordinal = 0;
+    for (size_t i = 0; i < segment_count; ++i) {
+        auto segment = make_shared<const IndexSegment>(IndexSegment::Map(reader, term_count));
+        CheckSnapshot(segment->GetFirstOrdinal() == end_ordinal);
+        end_ordinal = segment->GetEndOrdinal();
+        frozen_segments.push_back(move(segment));
+    }
+    CheckSnapshot(end_ordinal == document_count && reader.Read<uint64_t>() == SNAPSHOT_MAGIC);
+
+    unique_lock index_lock(index_mutex_);
+    stop_words_ = move(stop_words);
+    store_document_texts_ = store_document_texts;
+    applied_lsn_ = applied_lsn;
+    terms_ = move(terms);
+    document_freqs_.assign(document_freqs, document_freqs + term_count);
+    log_document_freqs_.assign(log_document_freqs, log_document_freqs + term_count);
+    term_fingerprints_.assign(term_fingerprints, term_fingerprints + term_count);
+    log_document_count_ = log_document_count;
+    documents_ = move(documents);
+    document_to_word_freqs_ = move(document_to_word_freqs);
+    document_fingerprints_.assign(document_fingerprints, document_fingerprints + document_count);
+    document_ordinals_ = move(document_ordinals);
+    document_ids_ = move(document_ids);
+    fingerprint_counts_ = move(fingerprint_counts);
+    document_texts_ = move(document_texts);
+    posting_count_ = static_cast<size_t>(posting_count);
+    removed_posting_count_ = static_cast<size_t>(removed_posting_count);
+    ordinals_to_compact_.assign(ordinals_to_compact, ordinals_to_compact + compact_count);
+    frozen_segments_ = move(frozen_segments);
+    open_segment_ = IndexSegment(static_cast<DocumentOrdinal>(document_count));
+    snapshot_file_ = move(file);
+}
+
+//Открытие журнала: записи новее снимка применяются обычными методами, пока журнал не подключен,
+//поэтому повторно не записываются
+void SearchServer::OpenMutationLog(const string& path) {
+    uint64_t applied_lsn;
+    {
+        lock_guard write_lock(write_mutex_);
+        if (mutation_log_) {
+            throw invalid_argument("Mutation log is already open"s);
+        }
+        applied_lsn = applied_lsn_;
+    }
+    auto log = make_unique<MutationLog>(path);
+    for (const MutationRecord& record : log->GetRecords()) {
+        if (record.lsn <= applied_lsn) {
+            continue;
+        }
+        ReplayMutation(record);
+        applied_lsn = record.lsn;
+        lock_guard write_lock(write_mutex_);
+        applied_lsn_ = applied_lsn;
+    }
+    log->ReleaseRecords();
+    log->SkipTo(applied_lsn);
+    lock_guard write_lock(write_mutex_);
+    //Воспроизведенные удаления только пометили документы: сегменты перестраиваются не чаще одного раза
+    if (removed_posting_count_ * 2 > posting_count_) {
+        CompactSegments(execution::par);
+    }
+    mutation_log_ = move(log);
+}
+
+//Снимок сохраняется под той же блокировкой, что и очистка журнала: между ними не проходит ни одно изменение.
+//Сбой после замены снимка безопасен - записи журнала не новее снимка при открытии пропускаются
+//Журнал очищается, только когда снимок и его переименование уже сброшены на диск: иначе после сбоя
+//мог бы вернуться прежний снимок при пустом журнале
+void SearchServer::Checkpoint(const string& snapshot_path) {
+    lock_guard write_lock(write_mutex_);
+    SaveSnapshotLocked(snapshot_path);
+    if (mutation_log_) {
+        mutation_log_->Clear();
+    }
+}
+
+template <typename Encoder>
+SearchServer::LogTicket SearchServer::LogMutation(MutationType type, Encoder encode) {
+    if (!mutation_log_) {
+        return {};
+    }
+    MutationEncoder body;
+    encode(body);
+    applied_lsn_ = mutation_log_->Append(type, body.GetBytes());
+    return { mutation_log_.get(), applied_lsn_ };
+}
+
+//Тело записи разбирается целиком до применения
+void SearchServer::ReplayMutation(const MutationRecord& record) {
+    MutationDecoder body(record.body);
+    switch (record.type) {
+    case MutationType::ADD_DOCUMENTS: {
+        vector<NewDocument> documents(body.Get<uint32_t>());
+        for (NewDocument& document : documents) {
+            document.id = body.Get<int32_t>();
+            document.status = static_cast<DocumentStatus>(body.Get<uint8_t>());
+            document.ratings.resize(body.Get<uint32_t>());
+            for (int& rating : document.ratings) {
+                rating = body.Get<int32_t>();
+            }
+            document.text = body.GetString();
+        }
+        if (!body.AtEnd()) {
+            throw runtime_error("Mutation log record is corrupted"s);
+        }
+        AddDocuments(execution::par, documents);
+        break;
+    }
+    case MutationType::REMOVE_DOCUMENTS: {
+        vector<int> document_ids(body.Get<uint32_t>());
+        for (int& document_id : document_ids) {
+            document_id = body.Get<int32_t>();
+        }
+        if (!body.AtEnd()) {
+            throw runtime_error("Mutation log record is corrupted"s);
+        }
+        //Сжатие откладывается до конца воспроизведения: иначе каждая запись могла бы перестраивать сегменты
+        RemoveDocumentsBatch(execution::par, document_ids, false);
+        break;
+    }
+    case MutationType::SET_TEXT_STORAGE: {
+        const bool enabled = body.Get<uint8_t>() != 0;
+        if (!body.AtEnd()) {
+            throw runtime_error("Mutation log record is corrupted"s);
+        }
+        SetDocumentTextStorage(enabled);
+        break;
+    }
+    }
+}
@@ -1,16 +1,29 @@
 #pragma once
 #include "document.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "posting_list.h"
+#include "top_k_selector.h"
+#include "relevance_accumulator.h"
+#include "term_dictionary.h"
+#include "string_arena.h"
+#include "document_fingerprint.h"
+#include "index_segment.h"
+#include "mapped_file.h"
+#include "mutation_log.h"
 #include <string>
 #include <set>
 #include <vector>
 #include <tuple>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <stdexcept>
 #include <execution>
 #include <string_view>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 
 extern const int MAX_RESULT_DOCUMENT_COUNT;
 
@@ -19,7 +32,29 @@ static auto key_mapper = [](const Document& document) {
     return document.id;
 };
 
+//Параметры выдачи FindTopDocuments: сколько документов вернуть и сколько лучших пропустить перед ними
+struct SearchOptions {
+    size_t limit = static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT);
+    size_t offset = 0;
+};
+
+//Документ для пакетного добавления (AddDocuments); текст нужен только на время вызова
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+//Параметры сегментов индекса (SetSegmentOptions)
+struct SegmentOptions {
+    size_t document_limit = 4096; //Открытый сегмент замораживается, когда в нем столько документов
+    size_t merge_factor = 4; //Столько соседних замороженных сегментов сливаются в один
+};
 
+//Запросы и чтение (константные методы) можно вызывать из любых потоков одновременно с добавлением, удалением
+//и сжатием индекса: они видят индекс до или после каждой записи целиком. Исключение - begin/end:
+//обход id во время записи требует внешней синхронизации
 class SearchServer {
 public:
 
@@ -46,6 +81,9 @@ public:
     {
     }
 
+    //Уничтожение дожидается фоновых слияний сегментов
+    ~SearchServer();
+
 
     //Методы begin и end
     std::set<int>::const_iterator begin() const{
@@ -59,32 +97,31 @@ public:
     //Возврат количества документов
     size_t GetDocumentCount() const;
 
-    //Добавление нового документа
+    //Добавление нового документа. Документы нумеруются 32-битными номерами;
+    //length_error, если номера исчерпаны
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    //Добавление документа, если в сервере нет документа с тем же множеством слов; false, если документ не добавлен.
+    //Некорректный документ вызывает те же исключения, что и в AddDocument
+    bool AddDocumentIfUnique(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    //Пакетное добавление документов: разбиение на слова и частичные индексы строятся параллельно,
+    //затем сливаются в основной индекс за один проход. Проверки те же, что в AddDocument, но выполняются
+    //до изменения индекса: при исключении не добавляется ни один документ пакета
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+
+    //Хранение текстов документов в сервере; действует на документы, добавленные после вызова
+    void SetDocumentTextStorage(bool enabled);
+
+    //Текст документа, если при добавлении документа хранение текстов было включено, иначе пустая строка
+    std::string_view GetDocumentText(int document_id) const;
+
     //Создание вектора наиболее релевантных документов для вывода
     template <typename KeyMapper>
     std::vector<Document> FindTopDocuments(const std::string_view query, KeyMapper key_mapper) const {
-        
-        Query structuredQuery = ParseQuery(query);
-        auto matched_documents = FindAllDocuments(structuredQuery, key_mapper);
-
-        //Сортировка по убыванию релевантности / возрастанию рейтинга
-        sort(matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-                    return lhs.rating > rhs.rating;
-                }
-                else {
-                    return lhs.relevance > rhs.relevance;
-                }
-            });
-
-        //Усечение вывода до требуемого максимума
-        if (matched_documents.size() > unsigned(MAX_RESULT_DOCUMENT_COUNT)) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
-        return matched_documents;
+        return FindTopDocuments(std::execution::seq, query, key_mapper, SearchOptions{});
     }
 
     //Создание вектора наиболее релевантных документов для вывода со статусом в качестве аргумента
@@ -97,6 +134,18 @@ public:
         return SearchServer::FindTopDocuments(raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
     }
 
+    //Страница выдачи: options.limit документов после options.offset лучших
+    template <typename KeyMapper>
+    std::vector<Document> FindTopDocuments(const std::string_view query, KeyMapper key_mapper, const SearchOptions& options) const {
+        return FindTopDocuments(std::execution::seq, query, key_mapper, options);
+    }
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus doc_status, const SearchOptions& options) const {
+        return SearchServer::FindTopDocuments(raw_query, [doc_status](int document_id, DocumentStatus status, int rating) { return status == doc_status; }, options);
+    }
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, const SearchOptions& options) const {
+        return SearchServer::FindTopDocuments(raw_query, DocumentStatus::ACTUAL, options);
+    }
+
     //FindTopDocuments с execution::seq
     template <typename KeyMapper>
     std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, const std::string_view query, KeyMapper key_mapper) const {
@@ -108,31 +157,29 @@ public:
     std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, const std::string_view raw_query) const {
         return SearchServer::FindTopDocuments(raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
     }
+    template <typename KeyMapper>
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, const std::string_view query, KeyMapper key_mapper, const SearchOptions& options) const {
+
+        std::vector<Document> matched_documents;
+        {
+            std::shared_lock lock(index_mutex_);
+            const Query& structuredQuery = ParseQuery(query);
+            matched_documents = FindAllDocuments(structuredQuery, key_mapper);
+        }
+        return SelectPage(std::execution::seq, matched_documents, options);
+    }
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, const std::string_view raw_query, DocumentStatus doc_status, const SearchOptions& options) const {
+        return SearchServer::FindTopDocuments(raw_query, doc_status, options);
+    }
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, const std::string_view raw_query, const SearchOptions& options) const {
+        return SearchServer::FindTopDocuments(raw_query, options);
+    }
 
 
     //Создание вектора наиболее релевантных документов для вывода (параллельные версии)
     template <typename KeyMapper>
     std::vector<Document> FindTopDocuments(std::execution::parallel_policy, const std::string_view query, KeyMapper key_mapper) const {
-
-        Query structuredQuery = ParseQuery(query);
-        auto matched_documents = FindAllDocuments(std::execution::par, structuredQuery, key_mapper);
-
-        //Сортировка по убыванию релевантности / возрастанию рейтинга
-        sort(std::execution::par, matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-                    return lhs.rating > rhs.rating;
-                }
-                else {
-                    return lhs.relevance > rhs.relevance;
-                }
-            });
-
-        //Усечение вывода до требуемого максимума
-        if (matched_documents.size() > unsigned(MAX_RESULT_DOCUMENT_COUNT)) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-        }
-        return matched_documents;
+        return FindTopDocuments(std::execution::par, query, key_mapper, SearchOptions{});
     }
 
     std::vector<Document> FindTopDocuments(std::execution::parallel_policy, const std::string_view raw_query, DocumentStatus doc_status) const {
@@ -143,14 +190,52 @@ public:
         return SearchServer::FindTopDocuments(std::execution::par, raw_query, [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
     }
 
+    template <typename KeyMapper>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, const std::string_view query, KeyMapper key_mapper, const SearchOptions& options) const {
+
+        std::vector<Document> matched_documents;
+        {
+            std::shared_lock lock(index_mutex_);
+            const Query& structuredQuery = ParseQuery(query);
+            matched_documents = FindAllDocuments(std::execution::par, structuredQuery, key_mapper);
+        }
+        return SelectPage(std::execution::par, matched_documents, options);
+    }
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, const std::string_view raw_query, DocumentStatus doc_status, const SearchOptions& options) const {
+        return SearchServer::FindTopDocuments(std::execution::par, raw_query, [doc_status](int document_id, DocumentStatus status, int rating) { return status == doc_status; }, options);
+    }
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, const std::string_view raw_query, const SearchOptions& options) const {
+        return SearchServer::FindTopDocuments(std::execution::par, raw_query, DocumentStatus::ACTUAL, options);
+    }
+
+    //Пакетный поиск: результат i совпадает с FindTopDocuments(queries[i]). Запросы разбираются все сразу
+    //и группируются по общим словам; в группе список словопозиций каждого слова распаковывается один раз,
+    //а вклады словопозиций раздаются всем запросам группы с этим словом. Группы считаются параллельно,
+    //весь пакет видит индекс в одном состоянии. invalid_argument, если хотя бы один запрос некорректен
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::sequenced_policy&, const std::vector<std::string>& queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::parallel_policy&, const std::vector<std::string>& queries) const;
+
+    //Пакетный поиск по отрезку [first, last) вектора запросов: части большого набора выполняются без копирования строк
+    using QueryIterator = std::vector<std::string>::const_iterator;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(QueryIterator first, QueryIterator last) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::sequenced_policy&, QueryIterator first, QueryIterator last) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::execution::parallel_policy&, QueryIterator first, QueryIterator last) const;
+
     //Метод возврата списка совпавших слов запроса
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const;
 
-    //Метод получения частот слов по id документа
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    //Метод получения частот слов по id документа (словарь собирается из индекса по запросу)
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    //Id дубликатов по возрастанию: документов, множество слов которых совпадает с документом с меньшим id.
+    //Сравниваются 128-битные отпечатки, которые поддерживаются при добавлении и удалении документов
+    std::vector<int> FindDuplicates() const;
 
     //Метод удаления документов из поискового сервера
     void RemoveDocument(int document_id);
@@ -159,122 +244,415 @@ public:
 
     void RemoveDocument(const std::execution::parallel_policy&, int document_id); 
 
+    //Пакетное удаление документов: слова документов делятся на группы, df каждого слова меняет один поток,
+    //документы помечаются удаленными, как в RemoveDocument. Все id проверяются до изменения
+    //индекса (исключение out_of_range, если документа нет), повторы id удаляются один раз
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::sequenced_policy&, const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids);
+
+    //Сжатие индекса: физическое удаление словопозиций удаленных документов. Перестраиваются только сегменты
+    //с удаленными документами, каждый один раз. Выполняется и автоматически, когда удаленные словопозиции
+    //составляют половину индекса. Если удаленные документы занимают больше половины номеров, все сегменты
+    //сливаются в один, а оставшиеся документы нумеруются заново: массивы по номеру документа и снимок больше
+    //не хранят удаленные. Хранимые тексты удаленных документов остаются в памяти до уничтожения сервера,
+    //чтобы не портить string_view, уже полученные из GetDocumentText
+    void CompactIndex();
+    void CompactIndex(const std::execution::sequenced_policy&);
+    void CompactIndex(const std::execution::parallel_policy&);
+
+    //Сжатие индекса в отдельном потоке; запросы ждут только замены перестроенных сегментов
+    std::future<void> CompactIndexAsync();
+
+    //Индекс состоит из открытого сегмента, куда дописываются новые документы, и замороженных сегментов.
+    //Заполненный открытый сегмент замораживается; соседние замороженные сегменты близкого размера
+    //сливаются в фоновом потоке, слияние убирает словопозиции удаленных документов.
+    //Параметры действуют на следующие заморозки и слияния
+    void SetSegmentOptions(const SegmentOptions& options);
+
+    //Число сегментов индекса, включая открытый, если в нем есть документы
+    size_t GetSegmentCount() const;
+
+    //Ожидание окончания фоновых слияний сегментов
+    void WaitForMerges();
+
+    //Сохранение индекса в двоичный снимок: стоп-слова, словарь, данные документов и сегменты со сжатыми
+    //списками словопозиций. Запросы во время сохранения выполняются, записи ждут его окончания.
+    //runtime_error при ошибке записи файла
+    void SaveSnapshot(const std::string& path) const;
+
+    //Загрузка снимка в пустой сервер. Файл отображается в память: слова, тексты документов и списки
+    //словопозиций читаются прямо из его страниц без копирования, поэтому страницы файла разделяются
+    //процессами, загрузившими тот же снимок. Списки один раз распаковываются для проверки: испорченный снимок
+    //отклоняется, а не читается за границами данных. Файл остается отображенным до уничтожения сервера,
+    //стоп-слова сервера заменяются стоп-словами снимка.
+    //Исключения: invalid_argument, если в сервере есть документы; runtime_error, если файл не открывается,
+    //не является снимком, записан другой версией формата или поврежден
+    void LoadSnapshot(const std::string& path);
+
+    //Открытие журнала изменений: добавления, удаления и SetDocumentTextStorage записываются в него и возвращают
+    //управление, когда запись оказалась на диске. Записи одновременных изменений сбрасываются на диск группой,
+    //одним fsync. Записи журнала новее загруженного снимка сначала применяются к серверу: снимок плюс журнал
+    //восстанавливают состояние на момент последнего сохраненного изменения; оборванный конец журнала отрезается.
+    //Вызывается до изменений сервера из других потоков. Исключения: invalid_argument, если журнал уже открыт;
+    //runtime_error, если файл не открывается или не является журналом. При ошибке записи журнала изменение
+    //остается в индексе, а оно и все следующие изменения бросают runtime_error
+    void OpenMutationLog(const std::string& path);
+
+    //Сохранение снимка (как SaveSnapshot) и очистка журнала изменений: его записи уже вошли в снимок
+    void Checkpoint(const std::string& snapshot_path);
+
 
 private:
     struct DocumentData {
+        int id;
         int rating;
         DocumentStatus status;
+        bool is_removed; //Документ удален, его словопозиции еще не убраны сжатием индекса
+        double inv_word_count; //TF слова = число его вхождений * inv_word_count
+    };
+
+    struct TermFrequency {
+        TermId term_id;
+        double term_freq;
     };
 
     std::set<std::string, std::less<>> stop_words_; //Список стоп-слов
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_; //Словарь "Слово" - "Документ - TF"
-    std::map<int, DocumentData> documents_; //Словарь "Документ" - "Рейтинг - Статус"
+    //Загруженный снимок: в его памяти лежат слова, тексты документов и списки словопозиций сегментов снимка
+    std::shared_ptr<const MappedFile> snapshot_file_;
+    TermDictionary terms_; //Словарь "Слово" - "TermId", хранит сами слова
+    //Сегменты делят номера документов на соседние диапазоны; в каждом сегменте у слова свой сжатый список
+    //словопозиций (Номер документа - число вхождений). Замороженные сегменты не меняются и заменяются целиком
+    std::vector<std::shared_ptr<const IndexSegment>> frozen_segments_; //По возрастанию номеров документов
+    IndexSegment open_segment_; //Документы после последнего замороженного сегмента
+    SegmentOptions segment_options_;
+    //IDF = log(N / df) хранится слагаемыми: логарифмы df пересчитываются только у слов измененного документа,
+    //логарифм числа документов - один раз на добавление или удаление, запрос лишь вычитает их
+    std::vector<uint32_t> document_freqs_; //"TermId" - "Число неудаленных документов со словом (df)"
+    std::vector<double> log_document_freqs_; //"TermId" - "log(df)"
+    double log_document_count_ = 0.0;
+    std::unordered_map<int, DocumentOrdinal> document_ordinals_; //Словарь "id документа" - "Номер документа"
+    std::vector<DocumentData> documents_; //Плоский массив "Номер документа" - "id - Рейтинг - Статус"
     std::set<int> document_ids_;
 
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::set<std::string, std::less<>> words_; //список слов
+    std::vector<std::vector<TermFrequency>> document_to_word_freqs_; //"Номер документа" - "TermId - TF" по возрастанию TermId
+
+    size_t posting_count_ = 0; //Словопозиции в списках, включая удаленные
+    size_t removed_posting_count_ = 0;
+    std::vector<DocumentOrdinal> ordinals_to_compact_; //Удаленные документы, словопозиции которых еще в сегментах
+
+    std::vector<DocumentFingerprint> term_fingerprints_; //"TermId" - "Отпечаток слова"
+    std::vector<DocumentFingerprint> document_fingerprints_; //"Номер документа" - "Отпечаток множества слов"
+    std::unordered_map<DocumentFingerprint, size_t, DocumentFingerprintHasher> fingerprint_counts_; //Число документов с отпечатком
+
+    bool store_document_texts_ = false;
+    StringArena document_text_storage_; //Тексты документов подряд в блоках памяти
+    std::vector<std::string_view> document_texts_; //"Номер документа" - "Текст"; короче documents_, если тексты не хранились
+
+    std::unique_ptr<MutationLog> mutation_log_; //Под write_mutex_
+    uint64_t applied_lsn_ = 0; //Номер последней записи журнала, вошедшей в индекс; сохраняется в снимке
+
+    //Запросы держат index_mutex_ на чтение. Записи выполняются по одной под write_mutex_ и берут index_mutex_
+    //монопольно только на время изменения индекса; разбиение текстов на слова и перестроение списков
+    //при сжатии идут без монопольной блокировки. Поля, которые читают только записи, защищены write_mutex_
+    mutable std::shared_mutex index_mutex_;
+    mutable std::mutex write_mutex_;
+    bool merge_running_ = false; //Под write_mutex_
+    std::shared_future<void> merge_future_; //Объявлен последним: поток слияния работает с остальными полями
+
+
+    //Запись журнала, которую изменение ждет после снятия блокировок
+    struct LogTicket {
+        MutationLog* log = nullptr;
+        uint64_t lsn = 0;
+
+        void Wait() const {
+            if (log) {
+                log->WaitDurable(lsn);
+            }
+        }
+    };
+
+    //Запись изменения в журнал, если он открыт: encode(MutationEncoder&) заполняет тело записи.
+    //Вызывается под write_mutex_ после изменения индекса, поэтому записи идут в порядке изменений
+    template <typename Encoder>
+    LogTicket LogMutation(MutationType type, Encoder encode);
 
+    //Применение записи журнала при его открытии
+    void ReplayMutation(const MutationRecord& record);
+
+    //Сохранение снимка; вызывается под write_mutex_
+    void SaveSnapshotLocked(const std::string& path) const;
+
+    //Номер документа по id (исключение, если документа нет)
+    DocumentOrdinal GetDocumentOrdinal(int document_id) const;
+
+    //Добавление документа; при reject_duplicate документ с уже имеющимся множеством слов не добавляется
+    bool IndexDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings, bool reject_duplicate);
+
+    //Расширение массивов по TermId до размера словаря
+    void ResizeTermArrays();
+
+    //Проверка, что номеров документов хватит еще на count документов; при нехватке освобождаются номера
+    //удаленных документов, length_error, если и их мало. Вызывается под write_mutex_ до блокировки index_mutex_
+    void ReserveOrdinals(size_t count);
+
+    //Перестроение сегментов с документами из ordinals_to_compact_; вызывается под write_mutex_ без блокировки index_mutex_
+    template <typename ExecutionPolicy>
+    void CompactSegments(ExecutionPolicy&& policy);
+
+    //Слияние всех сегментов в один с новыми номерами документов подряд с нуля и освобождение ячеек
+    //удаленных документов в массивах по номеру (тексты остаются в document_text_storage_);
+    //вызывается под write_mutex_ без блокировки index_mutex_
+    template <typename ExecutionPolicy>
+    void RenumberDocuments(ExecutionPolicy&& policy);
+
+    //Заморозка открытого сегмента, если в нем segment_options_.document_limit документов;
+    //вызывается под write_mutex_ и монопольной блокировкой index_mutex_
+    void FreezeFullOpenSegment();
+
+    //Запуск фонового слияния, если оно еще не идет; вызывается под write_mutex_
+    void ScheduleMerges();
+
+    //Фоновое слияние: пока есть сегменты для слияния, они сливаются без блокировок и заменяются монопольно
+    void RunMerges();
+
+    //Начало отрезка frozen_segments_ из merge_factor соседних сегментов для слияния;
+    //frozen_segments_.size(), если сливать нечего
+    size_t SelectMergeRange() const;
+
+    //Сегмент, в диапазон которого попадает номер документа
+    const IndexSegment& GetSegment(DocumentOrdinal ordinal) const;
+
+    //Обход сегментов по возрастанию номеров документов: function(segment)
+    template <typename Function>
+    void ForEachSegment(Function function) const {
+        for (const auto& segment : frozen_segments_) {
+            function(*segment);
+        }
+        function(open_segment_);
+    }
+
+    //Пакетное удаление; при allow_compaction сегменты перестраиваются, если удалена половина словопозиций
+    template <typename ExecutionPolicy>
+    void RemoveDocumentsBatch(ExecutionPolicy&& policy, const std::vector<int>& document_ids, bool allow_compaction);
+
+    //Копирование текста документа в сервер, если хранение текстов включено
+    void StoreDocumentText(DocumentOrdinal ordinal, std::string_view text);
+
+    //Удаление данных документа после удаления его словопозиций
+    void EraseDocumentData(int document_id, DocumentOrdinal ordinal);
 
     //Проверка входящего слова на принадлежность к стоп-словам
     bool IsStopWord(const std::string_view word) const;
 
-    //Разбивка строки запроса на вектор слов, исключая стоп-слова
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    //Порядок выдачи: по убыванию релевантности, при равной релевантности - по убыванию рейтинга
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+        if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
+            return lhs.rating > rhs.rating;
+        }
+        else {
+            return lhs.relevance > rhs.relevance;
+        }
+    }
+
+    //Отбор страницы выдачи: куча на offset + limit лучших, первые offset затем отбрасываются
+    template <typename ExecutionPolicy>
+    static std::vector<Document> SelectPage(ExecutionPolicy&& policy, const std::vector<Document>& matched_documents, const SearchOptions& options) {
+        if (options.limit == 0 || options.offset >= matched_documents.size()) {
+            return {};
+        }
+        const size_t window_end = options.offset + std::min(options.limit, matched_documents.size() - options.offset);
+        auto page = SelectTopK(policy, matched_documents.begin(), matched_documents.end(), window_end, IsMoreRelevant);
+        page.erase(page.begin(), page.begin() + options.offset);
+        return page;
+    }
 
     //Метод подсчета среднего рейтинга
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
-    struct QueryWord {
-        std::string_view data;
-        bool is_minus;
-        bool is_stop;
+    //Слова запроса, уже переведенные в TermId; слова, которых нет в индексе, отброшены
+    struct Query {
+        std::vector<TermId> plus_words; //По возрастанию, без повторов
+        std::vector<TermId> minus_words;
     };
 
-    //Отсечение "-" у минус-слов
-    QueryWord ParseQueryWord(std::string_view text) const;
+    //Разбор запроса в query за один проход; память векторов query переиспользуется
+    void ParseQuery(const std::string_view raw_query, Query& query) const;
 
-    struct Query {
-        std::set<std::string_view> plus_words;
-        std::set<std::string_view> minus_words;
-    };
+    //Разбор запроса в запрос текущего потока; ссылка действительна до следующего разбора в этом потоке
+    const Query& ParseQuery(const std::string_view raw_query) const;
+
+    //Отсечение "-" у минус-слова и добавление его TermId в query (стоп-слова и неизвестные слова пропускаются)
+    void AddQueryWord(std::string_view word, Query& query) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatchImpl(ExecutionPolicy&& policy, QueryIterator first, QueryIterator last) const;
+
+    //Поиск группы запросов пакета (номера query_indexes в queries) с записью выдачи в results;
+    //вызывается под блокировкой index_mutex_ на чтение
+    void FindQueryGroupTopDocuments(const std::vector<Query>& queries, const std::vector<size_t>& query_indexes,
+        std::vector<std::vector<Document>>& results) const;
+
+    //Запрос текущего потока (свой у каждого потока, переиспользуется между запросами)
+    static Query& GetThreadQuery();
+
+    //Накопитель релевантности текущего потока (свой у каждого потока, переиспользуется между запросами)
+    static RelevanceAccumulator& GetThreadAccumulator();
 
-    //Создание списков плюс- и минус-слов
-    Query ParseQuery(const std::string_view raw_query) const;
+    //Число частей диапазона номеров документов для параллельного поиска (не больше числа ядер)
+    static size_t GetScoringPartCount(size_t document_count);
 
-    //Вычисление IDF слова
-    double ComputeWordInverseDocumentFreq(const std::string_view) const;
+    //Число частей пакета для параллельного добавления (не больше числа ядер)
+    static size_t GetIndexingPartCount(size_t document_count);
+
+    template <typename ExecutionPolicy>
+    void AddDocumentsBatch(ExecutionPolicy&& policy, const std::vector<NewDocument>& documents);
+
+    //IDF слова из сохраненных логарифмов (слово должно встречаться хотя бы в одном документе)
+    double ComputeWordInverseDocumentFreq(TermId term_id) const {
+        return log_document_count_ - log_document_freqs_[term_id];
+    }
+
+    //Пересчет логарифма df слова после изменения его списка словопозиций
+    void UpdateDocumentFreq(TermId term_id);
 
     //Поиск всех подходящих по запросу документов
     template <typename KeyMapper>
     std::vector<Document> FindAllDocuments(const Query& query, KeyMapper key_mapper) const {
-        std::map<int, double> document_to_relevance;
-        for (const auto word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
+        //Плотный накопитель потока: без выделений памяти на каждую словопозицию
+        RelevanceAccumulator& document_to_relevance = GetThreadAccumulator();
+        document_to_relevance.Reset(documents_.size());
+        for (const TermId term_id : query.plus_words) {
+            if (document_freqs_[term_id] == 0) {
                 continue;
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                if (key_mapper(documents_.find(document_id)->first, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+            ForEachSegment([&](const IndexSegment& segment) {
+                const PostingList* postings = segment.Find(term_id);
+                if (postings == nullptr) {
+                    return;
                 }
-            }
+                postings->ForEach([&](DocumentOrdinal ordinal, uint32_t count) {
+                    const DocumentData& data = documents_[ordinal];
+                    if (!data.is_removed && key_mapper(data.id, data.status, data.rating)) {
+                        document_to_relevance.Add(ordinal, count * data.inv_word_count * inverse_document_freq);
+                    }
+                    });
+                });
         }
 
         //Исключение документов с минус-словами
-        for (const auto word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
-            }
+        for (const TermId term_id : query.minus_words) {
+            ForEachSegment([&](const IndexSegment& segment) {
+                if (const PostingList* postings = segment.Find(term_id)) {
+                    postings->ForEach([&](DocumentOrdinal ordinal, uint32_t) {
+                        document_to_relevance.Exclude(ordinal);
+                        });
+                }
+                });
         }
 
         //Создание вектора вывода поискового запроса
         std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance) {
+        matched_documents.reserve(document_to_relevance.TouchedCount());
+        document_to_relevance.ForEach([&](DocumentOrdinal ordinal, double relevance) {
             matched_documents.push_back({
-                document_id,
+                documents_[ordinal].id,
                 relevance,
-                documents_.at(document_id).rating
+                documents_[ordinal].rating
                 });
-        }
+            });
         return matched_documents;
     }
 
+    //Параллельный поиск: диапазон номеров документов делится на части, каждая часть считается
+    //в собственном накопителе потока, поэтому на словопозициях нет ни блокировок, ни общей памяти для записи.
+    //Сегменты не пересекаются по номерам документов, поэтому их выдачи просто склеиваются
     template <typename KeyMapper>
     std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query, KeyMapper key_mapper) const {
-        ConcurrentMap<int, double> document_to_relevance(4);
-        std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), 
-            [&](const auto word){
-                if (word_to_document_freqs_.count(word)) {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        if (key_mapper(documents_.find(document_id)->first, documents_.at(document_id).status, documents_.at(document_id).rating)) {
-                            document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                        }
-                    }
-                }   
+        //Списки словопозиций сегментов и IDF находятся один раз, до разбиения на части
+        struct SegmentPostings {
+            DocumentOrdinal first = 0;
+            DocumentOrdinal last = 0;
+            std::vector<std::pair<const PostingList*, double>> plus_postings;
+            std::vector<const PostingList*> minus_postings;
+        };
+        std::vector<SegmentPostings> segments;
+        ForEachSegment([&](const IndexSegment& segment) {
+            SegmentPostings entry;
+            entry.first = segment.GetFirstOrdinal();
+            entry.last = segment.GetEndOrdinal();
+            for (const TermId term_id : query.plus_words) {
+                const PostingList* postings = segment.Find(term_id);
+                if (postings != nullptr && document_freqs_[term_id] != 0) {
+                    entry.plus_postings.push_back({ postings, ComputeWordInverseDocumentFreq(term_id) });
+                }
+            }
+            for (const TermId term_id : query.minus_words) {
+                if (const PostingList* postings = segment.Find(term_id)) {
+                    entry.minus_postings.push_back(postings);
+                }
+            }
+            if (!entry.plus_postings.empty()) {
+                segments.push_back(std::move(entry));
+            }
             });
 
-        //Исключение документов с минус-словами
-        std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-            [&](const auto word) {
-                if (word_to_document_freqs_.count(word)) {
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        document_to_relevance.erase(document_id);
+        const size_t document_count = documents_.size();
+        const size_t part_count = GetScoringPartCount(document_count);
+        std::vector<std::vector<Document>> parts(part_count);
+        std::for_each(std::execution::par, parts.begin(), parts.end(),
+            [&](std::vector<Document>& part_documents) {
+                const size_t part = &part_documents - parts.data();
+                const auto first = static_cast<DocumentOrdinal>(document_count * part / part_count);
+                const auto last = static_cast<DocumentOrdinal>(document_count * (part + 1) / part_count);
+
+                RelevanceAccumulator& document_to_relevance = GetThreadAccumulator();
+                document_to_relevance.Reset(last - first, first);
+                for (const SegmentPostings& segment : segments) {
+                    if (segment.last <= first || segment.first >= last) {
+                        continue;
+                    }
+                    for (const auto& [postings, inverse_document_freq] : segment.plus_postings) {
+                        postings->ForEachInRange(first, last, [&, idf = inverse_document_freq](DocumentOrdinal ordinal, uint32_t count) {
+                            const DocumentData& data = documents_[ordinal];
+                            if (!data.is_removed && key_mapper(data.id, data.status, data.rating)) {
+                                document_to_relevance.Add(ordinal, count * data.inv_word_count * idf);
+                            }
+                            });
+                    }
+
+                    //Исключение документов с минус-словами
+                    for (const PostingList* postings : segment.minus_postings) {
+                        postings->ForEachInRange(first, last, [&](DocumentOrdinal ordinal, uint32_t) {
+                            document_to_relevance.Exclude(ordinal);
+                            });
                     }
                 }
+
+                part_documents.reserve(document_to_relevance.TouchedCount());
+                document_to_relevance.ForEach([&](DocumentOrdinal ordinal, double relevance) {
+                    part_documents.push_back({
+                        documents_[ordinal].id,
+                        relevance,
+                        documents_[ordinal].rating
+                        });
+                    });
             });
 
-        //Создание вектора вывода поискового запроса
+        //Создание вектора вывода поискового запроса: части просто склеиваются
+        if (part_count == 1) {
+            return std::move(parts.front());
+        }
+        size_t matched_count = 0;
+        for (const auto& part_documents : parts) {
+            matched_count += part_documents.size();
+        }
         std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-            matched_documents.push_back({
-                document_id,
-                relevance,
-                documents_.at(document_id).rating
-                });
+        matched_documents.reserve(matched_count);
+        for (const auto& part_documents : parts) {
+            matched_documents.insert(matched_documents.end(), part_documents.begin(), part_documents.end());
         }
         return matched_documents;
     }
@@ -0,0 +1,132 @@
+#include "snapshot_io.h"
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+    //Сброс записанного файла на диск: после сбоя питания под именем снимка не окажется недописанный файл,
+    //а журнал изменений, очищенный после сохранения снимка, не потеряет записи
+    bool SyncFile(const string& path) {
+#ifdef _WIN32
+        const HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        const bool synced = FlushFileBuffers(file) != 0;
+        CloseHandle(file);
+        return synced;
+#else
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        const bool synced = fsync(fd) == 0;
+        close(fd);
+        return synced;
+#endif
+    }
+
+#ifndef _WIN32
+    //Сброс каталога файла на диск: без него переименование может не пережить сбой питания,
+    //и под именем снимка вернется прежний файл
+    bool SyncDirectory(const string& path) {
+        const filesystem::path directory = filesystem::path(path).parent_path();
+        const int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            return false;
+        }
+        const bool synced = fsync(fd) == 0;
+        close(fd);
+        return synced;
+    }
+#endif
+}
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp"s)
+    , out_(temporary_path_, ios::binary | ios::trunc) {
+    if (!out_) {
+        throw runtime_error("Cannot create file "s + temporary_path_);
+    }
+}
+
+//Строки одним блоком: смещения (count + 1) и символы подряд
+void SnapshotWriter::WriteStrings(const vector<string_view>& strings) {
+    vector<uint64_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    offsets.push_back(0);
+    for (const string_view text : strings) {
+        offsets.push_back(offsets.back() + text.size());
+    }
+    Write<uint64_t>(strings.size());
+    WriteArray(offsets.data(), offsets.size());
+    Align();
+    for (const string_view text : strings) {
+        WriteBytes(text.data(), text.size());
+    }
+}
+
+//Сброс буферов на диск с проверкой ошибок записи и замена целевого файла записанным.
+//Возврат без исключения означает, что на диске и данные, и новое имя снимка
+void SnapshotWriter::Finish() {
+    out_.close();
+    if (!out_ || !SyncFile(temporary_path_)) {
+        throw runtime_error("Cannot write file "s + temporary_path_);
+    }
+#ifdef _WIN32
+    if (!MoveFileExA(temporary_path_.c_str(), path_.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        throw runtime_error("Cannot replace file "s + path_);
+    }
+#else
+    error_code error;
+    filesystem::rename(temporary_path_, path_, error);
+    if (error) {
+        throw runtime_error("Cannot replace file "s + path_ + ": "s + error.message());
+    }
+    if (!SyncDirectory(path_)) {
+        throw runtime_error("Cannot write directory of file "s + path_);
+    }
+#endif
+}
+
+void SnapshotWriter::Align() {
+    static const char padding[SNAPSHOT_ALIGNMENT] = {};
+    WriteBytes(padding, (SNAPSHOT_ALIGNMENT - offset_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+    offset_ += size;
+}
+
+//Строки блока WriteStrings; string_view указывают в исходные байты
+vector<string_view> SnapshotReader::ReadStrings() {
+    const auto count = Read<uint64_t>();
+    CheckSnapshot(count < size_);
+    const uint64_t* offsets = ReadArray<uint64_t>(count + 1);
+    CheckSnapshot(offsets[0] == 0);
+    for (size_t i = 0; i < count; ++i) {
+        CheckSnapshot(offsets[i] <= offsets[i + 1]);
+    }
+    const char* chars = ReadArray<char>(offsets[count]);
+    vector<string_view> strings;
+    strings.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        strings.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
+
+void SnapshotReader::Align() {
+    offset_ = min(size_, (offset_ + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+//Двоичный снимок индекса - последовательность значений и массивов в порядке байтов процессора.
+//Каждое значение выровнено на SNAPSHOT_ALIGNMENT байт, поэтому массивы снимка, отображенного в память,
+//читаются по указателям прямо из его страниц. При загрузке проверяются заголовки и границы массивов,
+//поэтому усеченный или чужой файл отклоняется; отображенные списки словопозиций проверяются целиком -
+//каждый блок и хвост распаковываются один раз
+constexpr uint64_t SNAPSHOT_MAGIC = 0x315350414E535359ULL; //Байты "YSSNAPS1" в начале файла
+constexpr uint32_t SNAPSHOT_VERSION = 2; //Версия 2 хранит номер последней записи журнала изменений; версия 1 тоже читается
+constexpr uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304; //Отличает снимки с другим порядком байтов
+constexpr size_t SNAPSHOT_ALIGNMENT = 8;
+
+//Последовательная запись снимка; runtime_error при ошибке ввода-вывода. Данные пишутся во временный файл
+//рядом с целевым и заменяют его только в Finish, поэтому серверы, отобразившие прежний снимок, продолжают
+//читать его страницы, а оборванная запись не портит прежний снимок
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    template <typename T>
+    void WriteArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshot stores only trivially copyable values");
+        Align();
+        WriteBytes(values, count * sizeof(T));
+    }
+
+    template <typename T>
+    void Write(const T& value) {
+        WriteArray(&value, 1);
+    }
+
+    //Строки одним блоком: смещения (count + 1) и символы подряд
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+    //Сброс буферов на диск с проверкой ошибок записи и замена целевого файла записанным; после возврата
+    //на диске и данные снимка, и запись каталога о новом имени
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    uint64_t offset_ = 0;
+
+    void Align();
+    void WriteBytes(const void* data, size_t size);
+};
+
+//Чтение снимка из памяти без копирования: массивы возвращаются указателями на исходные байты.
+//runtime_error, если данные кончаются раньше времени
+class SnapshotReader {
+public:
+    SnapshotReader(const uint8_t* data, size_t size)
+        : data_(data)
+        , size_(size) {
+    }
+
+    template <typename T>
+    const T* ReadArray(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "Snapshot stores only trivially copyable values");
+        Align();
+        if (count > (size_ - offset_) / sizeof(T)) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        const T* values = reinterpret_cast<const T*>(data_ + offset_);
+        offset_ += count * sizeof(T);
+        return values;
+    }
+
+    template <typename T>
+    T Read() {
+        return *ReadArray<T>(1);
+    }
+
+    //Строки блока WriteStrings; string_view указывают в исходные байты
+    std::vector<std::string_view> ReadStrings();
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t offset_ = 0;
+
+    void Align();
+};
+
+//Исключение о поврежденном снимке, если условие не выполнено
+inline void CheckSnapshot(bool condition) {
+    if (!condition) {
+        throw std::runtime_error("Snapshot is corrupted");
+    }
+}
@@ -0,0 +1,34 @@
+#include "string_arena.h"
+#include <cstring>
+
+using namespace std;
+
+//Копирование строки в хранилище
+string_view StringArena::Store(string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    char* data;
+    //Длинная строка получает собственный блок, текущий блок продолжает заполняться
+    if (text.size() > CHUNK_SIZE / 4) {
+        data = AllocateChunk(text.size());
+    }
+    else {
+        if (text.size() > free_size_) {
+            free_begin_ = AllocateChunk(CHUNK_SIZE);
+            free_size_ = CHUNK_SIZE;
+        }
+        data = free_begin_;
+        free_begin_ += text.size();
+        free_size_ -= text.size();
+    }
+    memcpy(data, text.data(), text.size());
+    used_size_ += text.size();
+    return { data, text.size() };
+}
+
+char* StringArena::AllocateChunk(size_t size) {
+    chunks_.push_back(make_unique<char[]>(size));
+    allocated_size_ += size;
+    return chunks_.back().get();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+//Хранилище строк блоками: строки лежат подряд в больших блоках памяти, выдаваемые string_view
+//действительны все время жизни хранилища. Отдельные строки не освобождаются
+class StringArena {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    //Копирование строки в хранилище
+    std::string_view Store(std::string_view text);
+
+    //Объем выделенных блоков в байтах
+    size_t GetAllocatedSize() const {
+        return allocated_size_;
+    }
+
+    //Объем сохраненных строк в байтах
+    size_t GetUsedSize() const {
+        return used_size_;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* free_begin_ = nullptr; //Свободное место текущего блока
+    size_t free_size_ = 0;
+    size_t allocated_size_ = 0;
+    size_t used_size_ = 0;
+
+    char* AllocateChunk(size_t size);
+};
@@ -1,19 +1,125 @@
 #include "string_processing.h"
+#include "cpu_features.h"
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
-vector<string_view> SplitIntoWords(string_view str) {
-    vector<string_view> result;
-    while (true) {
-        uint64_t space = str.find(' ');
-        if (str[0] != ' ') {
-            result.push_back(str.substr(0, space));
+namespace {
+    bool IsSpecialSymbol(char c) {
+        return static_cast<unsigned char>(c) < ' ';
+    }
+
+    //Маски символов [begin, size) фрагмента; элементы масок до begin уже заполнены
+    bool ScanTextScalar(string_view block, size_t begin, uint64_t* space_masks) {
+        bool has_special_symbols = false;
+        for (size_t i = begin; i < block.size(); ++i) {
+            if (i % 64 == 0) {
+                space_masks[i / 64] = 0;
+            }
+            space_masks[i / 64] |= static_cast<uint64_t>(block[i] == ' ') << (i % 64);
+            has_special_symbols |= IsSpecialSymbol(block[i]);
         }
-        if (space == str.npos) {
-            break;
+        return has_special_symbols;
+    }
+
+    bool ScanTextBlockScalar(string_view block, uint64_t* space_masks) {
+        return ScanTextScalar(block, 0, space_masks);
+    }
+
+#ifdef CPU_FEATURES_X86
+    //16 символов за шаг: пробелы - сравнением на равенство, спецсимволы - беззнаковым min(c, 31) == c
+    CPU_TARGET("sse2")
+    bool ScanTextBlockSse2(string_view block, uint64_t* space_masks) {
+        const __m128i spaces = _mm_set1_epi8(' ');
+        const __m128i last_special = _mm_set1_epi8(' ' - 1);
+        __m128i special = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 16 <= block.size(); i += 16) {
+            const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block.data() + i));
+            const auto space_bits = static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, spaces)));
+            if (i % 64 == 0) {
+                space_masks[i / 64] = 0;
+            }
+            space_masks[i / 64] |= space_bits << (i % 64);
+            special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(chars, last_special), chars));
         }
-        else {
-            str.remove_prefix(space + 1);
+        const bool has_special_symbols = _mm_movemask_epi8(special) != 0;
+        return ScanTextScalar(block, i, space_masks) || has_special_symbols;
+    }
+
+    //32 символа за шаг, те же сравнения на 256-битных регистрах
+    CPU_TARGET("avx2")
+    bool ScanTextBlockAvx2(string_view block, uint64_t* space_masks) {
+        const __m256i spaces = _mm256_set1_epi8(' ');
+        const __m256i last_special = _mm256_set1_epi8(' ' - 1);
+        __m256i special = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= block.size(); i += 32) {
+            const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.data() + i));
+            const auto space_bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, spaces)));
+            if (i % 64 == 0) {
+                space_masks[i / 64] = 0;
+            }
+            space_masks[i / 64] |= static_cast<uint64_t>(space_bits) << (i % 64);
+            special = _mm256_or_si256(special, _mm256_cmpeq_epi8(_mm256_min_epu8(chars, last_special), chars));
         }
+        const bool has_special_symbols = _mm256_movemask_epi8(special) != 0;
+        return ScanTextScalar(block, i, space_masks) || has_special_symbols;
     }
+#endif
+
+    struct TextScanKernel {
+        bool (*scan)(string_view, uint64_t*);
+        const char* name;
+    };
+
+    TextScanKernel SelectKernel() {
+#ifdef CPU_FEATURES_X86
+        const CpuFeatures& features = GetCpuFeatures();
+        if (features.avx2) {
+            return { ScanTextBlockAvx2, "avx2" };
+        }
+        if (features.sse2) {
+            return { ScanTextBlockSse2, "sse2" };
+        }
+#endif
+        return { ScanTextBlockScalar, "scalar" };
+    }
+
+    const TextScanKernel& GetKernel() {
+        static const TextScanKernel kernel = SelectKernel();
+        return kernel;
+    }
+}
+
+//Проход по фрагменту не длиннее TEXT_BLOCK_SIZE: маска пробелов и признак спецсимволов
+bool ScanTextBlock(string_view block, uint64_t* space_masks) {
+    return GetKernel().scan(block, space_masks);
+}
+
+//Название выбранного ядра разбора текста ("avx2", "sse2" или "scalar")
+const char* GetTextScanKernelName() {
+    return GetKernel().name;
+}
+
+//Проверка текста на спецсимволы (коды 0-31)
+bool HasSpecialSymbols(string_view text) {
+    uint64_t space_masks[TEXT_BLOCK_SIZE / 64];
+    for (size_t block = 0; block < text.size(); block += TEXT_BLOCK_SIZE) {
+        if (ScanTextBlock(text.substr(block, TEXT_BLOCK_SIZE), space_masks)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+vector<string_view> SplitIntoWords(string_view str) {
+    vector<string_view> result;
+    ForEachWord(str, [&result](string_view word) {
+        result.push_back(word);
+        });
     return result;
-}
\ No newline at end of file
+}
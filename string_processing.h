@@ -1,5 +1,62 @@
 #pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 #include <vector>
 
-std::vector<std::string_view> SplitIntoWords(std::string_view text);
\ No newline at end of file
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Размер фрагмента текста, для которого за один проход строится маска пробелов
+constexpr size_t TEXT_BLOCK_SIZE = 1024;
+
+//Проход по фрагменту не длиннее TEXT_BLOCK_SIZE: бит i элемента space_masks[i / 64] равен 1, если символ i - пробел.
+//Возвращает true, если во фрагменте есть спецсимволы (коды 0-31). Выполняется AVX2-, SSE2- или скалярным ядром
+bool ScanTextBlock(std::string_view block, uint64_t* space_masks);
+
+//Название выбранного ядра разбора текста ("avx2", "sse2" или "scalar")
+const char* GetTextScanKernelName();
+
+//Номер младшего единичного бита (mask != 0)
+inline size_t CountTrailingZeros(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return index;
+#else
+    return static_cast<size_t>(__builtin_ctzll(mask));
+#endif
+}
+
+//Обход слов текста (непустых последовательностей символов между пробелами) без создания вектора: function(word).
+//Границы слов и спецсимволы ищутся за один проход; возвращает false, если в тексте есть спецсимволы
+template <typename Function>
+bool ForEachWord(std::string_view text, Function function) {
+    uint64_t space_masks[TEXT_BLOCK_SIZE / 64];
+    bool has_special_symbols = false;
+    size_t word_begin = 0;
+    for (size_t block = 0; block < text.size(); block += TEXT_BLOCK_SIZE) {
+        const size_t block_size = std::min(TEXT_BLOCK_SIZE, text.size() - block);
+        has_special_symbols |= ScanTextBlock(text.substr(block, block_size), space_masks);
+        for (size_t i = 0; i * 64 < block_size; ++i) {
+            for (uint64_t mask = space_masks[i]; mask != 0; mask &= mask - 1) {
+                const size_t space = block + i * 64 + CountTrailingZeros(mask);
+                if (word_begin < space) {
+                    function(text.substr(word_begin, space - word_begin));
+                }
+                word_begin = space + 1;
+            }
+        }
+    }
+    if (word_begin < text.size()) {
+        function(text.substr(word_begin));
+    }
+    return !has_special_symbols;
+}
+
+//Проверка текста на спецсимволы (коды 0-31)
+bool HasSpecialSymbols(std::string_view text);
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text);
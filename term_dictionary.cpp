@@ -0,0 +1,30 @@
+#include "term_dictionary.h"
+
+using namespace std;
+
+//Идентификатор слова; новое слово копируется в словарь
+TermId TermDictionary::Intern(string_view term) {
+    const auto it = term_ids_.find(term);
+    if (it != term_ids_.end()) {
+        return it->second;
+    }
+    const auto term_id = static_cast<TermId>(terms_.size());
+    const string_view stored_term = storage_.Store(term);
+    terms_.push_back(stored_term);
+    term_ids_.emplace(stored_term, term_id);
+    return term_id;
+}
+
+//Добавление нового слова без копирования: память слова должна жить дольше словаря
+TermId TermDictionary::AddExternal(string_view term) {
+    const auto term_id = static_cast<TermId>(terms_.size());
+    terms_.push_back(term);
+    term_ids_.emplace(term, term_id);
+    return term_id;
+}
+
+//Идентификатор слова или NO_TERM, если слова в словаре нет
+TermId TermDictionary::Find(string_view term) const {
+    const auto it = term_ids_.find(term);
+    return it == term_ids_.end() ? NO_TERM : it->second;
+}
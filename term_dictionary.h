@@ -0,0 +1,44 @@
+#pragma once
+#include "string_arena.h"
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//Плотный целочисленный идентификатор слова (индекс в массивах индекса SearchServer)
+using TermId = uint32_t;
+
+//Словарь слов: каждое слово хранится один раз и получает TermId по порядку добавления
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+    //Идентификатор слова; новое слово копируется в словарь
+    TermId Intern(std::string_view term);
+
+    //Добавление нового слова без копирования: память слова должна жить дольше словаря (например, снимок индекса)
+    TermId AddExternal(std::string_view term);
+
+    //Идентификатор слова или NO_TERM, если слова в словаре нет
+    TermId Find(std::string_view term) const;
+
+    //Слово по идентификатору; ссылка действительна все время жизни словаря
+    std::string_view GetTerm(TermId term_id) const {
+        return terms_[term_id];
+    }
+
+    size_t size() const {
+        return terms_.size();
+    }
+
+    //Объем памяти под сами слова в байтах
+    size_t GetStorageSize() const {
+        return storage_.GetAllocatedSize();
+    }
+
+private:
+    StringArena storage_; //Слова лежат подряд, без отдельного выделения памяти на каждое
+    std::vector<std::string_view> terms_; //"TermId" - "Слово"
+    std::unordered_map<std::string_view, TermId> term_ids_; //"Слово" - "TermId"
+};
@@ -1,5 +1,14 @@
 #include "test_example_functions.h"
 #include "search_server.h"
+#include "remove_duplicates.h"
+#include "near_duplicates.h"
+#include "corpus_loader.h"
+#include "process_queries.h"
+#include "concurrent_map.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
 
 using namespace std;
 
@@ -153,6 +162,631 @@ void TestRelevanceCalculation() {
     ASSERT_HINT(abs(found_docs[1].relevance - rel_doc0) < 1e-6, "Relevance is calculated incorrectly"s);
 }
 
+void TestRemovingDocument() {
+    SearchServer server("in the"s);
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    server.AddDocument(43, "dog in the city"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    server.AddDocument(44, "in the"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    server.RemoveDocument(42);
+    ASSERT_HINT(server.GetDocumentCount() == 2, "Document is not removed"s);
+    ASSERT_HINT(server.FindTopDocuments("cat"s).empty(), "Removed document is still found"s);
+    const auto found_docs = server.FindTopDocuments("city"s);
+    ASSERT_HINT(found_docs.size() == 1 && found_docs[0].id == 43, "Removing breaks other documents"s);
+    //   -  
+    server.RemoveDocument(std::execution::par, 44);
+    ASSERT_HINT(server.GetDocumentCount() == 1, "Document without words is not removed"s);
+}
+
+void TestResultPagination() {
+    SearchServer server;
+    for (int id = 0; id < 10; ++id) {
+        server.AddDocument(id, "cat city"s, DocumentStatus::ACTUAL, { id });
+    }
+    //       , ..  id 9  id 0
+    const auto first_page = server.FindTopDocuments("cat"s, SearchOptions{ 3, 0 });
+    ASSERT_HINT(first_page.size() == 3 && first_page[0].id == 9 && first_page[2].id == 7, "First page is wrong"s);
+    const auto third_page = server.FindTopDocuments(std::execution::par, "cat"s, SearchOptions{ 3, 6 });
+    ASSERT_HINT(third_page.size() == 3 && third_page[0].id == 3 && third_page[2].id == 1, "Page with offset is wrong"s);
+    const auto last_page = server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, SearchOptions{ 3, 9 });
+    ASSERT_HINT(last_page.size() == 1 && last_page[0].id == 0, "Incomplete last page is wrong"s);
+    ASSERT_HINT(server.FindTopDocuments("cat"s, SearchOptions{ 3, 10 }).empty(), "Page after the end must be empty"s);
+    ASSERT_HINT(server.FindTopDocuments("cat"s).size() == 5, "Default limit is not applied"s);
+}
+
+//  ; "and"  -  ,   
+const vector<string> CORPUS_WORDS = { "cat"s, "dog"s, "city"s, "park"s, "tail"s, "bird"s, "and"s };
+
+//  :      CORPUS_WORDS,   id   ,
+//         
+vector<string> MakeCorpusTexts(int document_count) {
+    vector<string> texts;
+    texts.reserve(document_count);
+    for (int id = 0; id < document_count; ++id) {
+        texts.push_back(CORPUS_WORDS[id % 7] + " "s + CORPUS_WORDS[id * 3 % 5] + " "s + CORPUS_WORDS[id * 5 % 6] + " "s + CORPUS_WORDS[id % 4]);
+    }
+    return texts;
+}
+
+//      
+void AssertSameTopDocuments(const vector<Document>& expected, const vector<Document>& found, const string& hint) {
+    ASSERT_HINT(found.size() == expected.size(), hint);
+    for (size_t i = 0; i < found.size(); ++i) {
+        ASSERT_HINT(found[i].id == expected[i].id && abs(found[i].relevance - expected[i].relevance) < 1e-6, hint);
+    }
+}
+
+void TestAddingDocumentsBatch() {
+    const vector<string> texts = MakeCorpusTexts(300);
+    SearchServer one_by_one("and"s);
+    SearchServer batch("and"s);
+    vector<NewDocument> documents;
+    for (int id = 0; id < 300; ++id) {
+        const DocumentStatus status = id % 3 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+        one_by_one.AddDocument(id, texts[id], status, { id, 1 });
+        documents.push_back({ id, texts[id], status, { id, 1 } });
+    }
+    batch.AddDocuments(documents);
+    ASSERT_HINT(batch.GetDocumentCount() == 300, "Batch is not added"s);
+    //    ,     :   df, TF  
+    for (const string& query : { "cat"s, "dog -park"s, "city tail and"s }) {
+        AssertSameTopDocuments(one_by_one.FindTopDocuments(query), batch.FindTopDocuments(query), "Batch index differs from single additions"s);
+        AssertSameTopDocuments(one_by_one.FindTopDocuments(query, DocumentStatus::BANNED), batch.FindTopDocuments(query, DocumentStatus::BANNED),
+            "Batch index loses document statuses"s);
+    }
+    ASSERT_HINT(batch.MatchDocument("bird and city"s, 5) == one_by_one.MatchDocument("bird and city"s, 5), "Batch index differs in matching"s);
+    //        
+    try {
+        batch.AddDocuments(std::execution::seq, { { 500, "owl"s, DocumentStatus::ACTUAL, {} }, { 500, "fish"s, DocumentStatus::ACTUAL, {} } });
+        ASSERT_HINT(false, "Duplicate id in batch is not rejected"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ASSERT_HINT(batch.GetDocumentCount() == 300 && batch.FindTopDocuments("owl"s).empty(), "Rejected batch is partially added"s);
+}
+
+void TestDocumentTextStorage() {
+    SearchServer server;
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_HINT(server.GetDocumentText(1).empty(), "Text is stored without request"s);
+    server.SetDocumentTextStorage(true);
+    {
+        //    :     
+        string text = "dog in the park"s;
+        server.AddDocument(2, text, DocumentStatus::ACTUAL, { 1 });
+        string batch_text(100000, 'a');
+        server.AddDocuments({ { 3, batch_text, DocumentStatus::ACTUAL, {} } });
+    }
+    ASSERT_HINT(server.GetDocumentText(2) == "dog in the park"sv, "Stored text is wrong"s);
+    ASSERT_HINT(server.GetDocumentText(3) == string(100000, 'a'), "Long stored text is wrong"s);
+    server.RemoveDocument(2);
+    try {
+        server.GetDocumentText(2);
+        ASSERT_HINT(false, "Text of removed document is returned"s);
+    }
+    catch (const out_of_range&) {
+    }
+}
+
+void TestDuplicateDetection() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    //,   -     
+    server.AddDocument(3, "rat nasty pet funny funny"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(4, "curly hair pet funny and"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(5, "funny pet"s, DocumentStatus::ACTUAL, { 1, 2 });
+    ASSERT_HINT((server.FindDuplicates() == vector<int>{ 3, 4 }), "Duplicates are found incorrectly"s);
+    ASSERT_HINT(!server.AddDocumentIfUnique(6, "pet funny with rat nasty"s, DocumentStatus::ACTUAL, { 1 }), "Duplicate is added"s);
+    ASSERT_HINT(server.AddDocumentIfUnique(7, "funny pet rat"s, DocumentStatus::ACTUAL, { 1 }), "Unique document is rejected"s);
+    server.RemoveDocument(1);
+    ASSERT_HINT((server.FindDuplicates() == vector<int>{ 4 }), "Duplicates are not updated on removal"s);
+    RemoveDuplicates(server);
+    ASSERT_HINT(server.GetDocumentCount() == 4 && server.FindDuplicates().empty(), "Duplicates are not removed"s);
+}
+
+void TestNearDuplicates() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and fashionable collar with long tail"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "black dog with expressive eyes in the park"s, DocumentStatus::ACTUAL, { 1 });
+    //  :   6 / 8
+    server.AddDocument(3, "white cat and fashionable collar with short tail"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(4, "black dog with expressive eyes in the garden"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(5, "well groomed starling evgeny"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(6, "and"s, DocumentStatus::ACTUAL, { 1 });
+    const vector<vector<int>> expected = { { 1, 3 }, { 2, 4 } };
+    ASSERT_HINT(FindNearDuplicates(server, NearDuplicateOptions{ 0.7 }) == expected, "Near duplicates are not clustered"s);
+    ASSERT_HINT(FindNearDuplicates(std::execution::seq, server, NearDuplicateOptions{ 0.7 }) == expected, "Sequential near duplicates differ"s);
+    ASSERT_HINT(FindNearDuplicates(server, NearDuplicateOptions{ 0.9 }).empty(), "Threshold is not applied"s);
+}
+
+void TestIndexCompaction() {
+    SearchServer server;
+    for (int id = 0; id < 8; ++id) {
+        server.AddDocument(id, id % 2 ? "cat city"s : "dog city"s, DocumentStatus::ACTUAL, { id });
+    }
+    //       df ,   
+    server.RemoveDocument(1);
+    server.RemoveDocument(3);
+    const auto before = server.FindTopDocuments("cat -dog"s);
+    ASSERT_HINT(before.size() == 2 && before[0].id == 7 && before[1].id == 5, "Removed documents are found"s);
+    ASSERT_HINT(abs(before[0].relevance - 0.549306) < 1e-6, "IDF counts removed documents"s);
+    server.CompactIndex();
+    const auto after = server.FindTopDocuments("cat -dog"s);
+    ASSERT_HINT(after.size() == 2 && after[0].id == 7 && abs(after[0].relevance - before[0].relevance) < 1e-6, "Compaction changes results"s);
+
+    //      ,    :
+    //  ,   ,      
+    const string path = "test_index_compaction.bin"s;
+    const vector<string> texts = MakeCorpusTexts(90);
+    SearchServer renumbered;
+    renumbered.SetSegmentOptions({ 8, 2 });
+    renumbered.SetDocumentTextStorage(true);
+    SearchServer live;
+    live.SetDocumentTextStorage(true);
+    for (int id = 0; id < 90; ++id) {
+        renumbered.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        if (id % 3 == 0) {
+            live.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        }
+    }
+    for (int id = 0; id < 90; ++id) {
+        if (id % 3 != 0) {
+            renumbered.RemoveDocument(id);
+        }
+    }
+    renumbered.CompactIndex();
+    ASSERT_HINT(renumbered.GetSegmentCount() == 1, "Renumbering leaves several segments"s);
+    const auto snapshot_size = [&path](const SearchServer& server) {
+        server.SaveSnapshot(path);
+        return ifstream(path, ios::binary | ios::ate).tellg();
+    };
+    ASSERT_HINT(snapshot_size(renumbered) <= snapshot_size(live), "Snapshot keeps removed documents"s);
+    std::remove(path.c_str());
+
+    //   
+    for (SearchServer* server : { &renumbered, &live }) {
+        server->AddDocument(100, "cat owl"s, DocumentStatus::ACTUAL, { 5 });
+        server->RemoveDocuments({ 3, 6 });
+    }
+    for (const string& query : { "cat -dog"s, "city park"s, "tail owl"s }) {
+        AssertSameTopDocuments(live.FindTopDocuments(query), renumbered.FindTopDocuments(query), "Renumbering changes results"s);
+        AssertSameTopDocuments(live.FindTopDocuments(query), renumbered.FindTopDocuments(std::execution::par, query), "Renumbering changes results"s);
+        ASSERT_HINT(renumbered.MatchDocument(query, 87) == live.MatchDocument(query, 87), "Renumbering changes matching"s);
+    }
+    ASSERT_HINT(renumbered.GetDocumentText(87) == texts[87] && renumbered.GetDocumentText(100) == "cat owl"s, "Renumbering loses document texts"s);
+}
+
+void TestRemovingDocumentsBatch() {
+    const vector<string> texts = MakeCorpusTexts(300);
+    SearchServer one_by_one;
+    SearchServer batch;
+    SearchServer sequential_batch;
+    for (int id = 0; id < 300; ++id) {
+        for (SearchServer* server : { &one_by_one, &batch, &sequential_batch }) {
+            server->AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        }
+    }
+    vector<int> removed_ids;
+    for (int id = 0; id < 300; id += 3) {
+        one_by_one.RemoveDocument(id);
+        removed_ids.push_back(id);
+    }
+    // id    : df     
+    removed_ids.push_back(0);
+    batch.RemoveDocuments(removed_ids);
+    sequential_batch.RemoveDocuments(std::execution::seq, removed_ids);
+    ASSERT_HINT(batch.GetDocumentCount() == 200 && sequential_batch.GetDocumentCount() == 200, "Batch is not removed"s);
+    for (const string& query : { "cat"s, "dog -park"s, "city tail"s }) {
+        const auto expected = one_by_one.FindTopDocuments(query);
+        AssertSameTopDocuments(expected, batch.FindTopDocuments(query), "Batch removal differs from single removals"s);
+        AssertSameTopDocuments(expected, sequential_batch.FindTopDocuments(query), "Sequential batch removal differs from single removals"s);
+    }
+    // id    
+    try {
+        batch.RemoveDocuments(std::execution::seq, { 1, 3 });
+        ASSERT_HINT(false, "Missing id is not reported"s);
+    }
+    catch (const out_of_range&) {
+    }
+    ASSERT_HINT(batch.GetDocumentCount() == 200 && get<0>(batch.MatchDocument("cat dog city park tail bird"s, 1)).size() > 0,
+        "Rejected batch is partially removed"s);
+}
+
+void TestConcurrentMap() {
+    //   16 :   ,    
+    ConcurrentMap<int, int> counts(2);
+    ConcurrentMap<int, double> sums(2);
+    vector<thread> writers;
+    for (int thread_index = 0; thread_index < 4; ++thread_index) {
+        writers.emplace_back([&, thread_index] {
+            for (int key = 0; key < 5000; ++key) {
+                counts.Add(key, 1);
+                sums.Add(key % 100, 0.5);
+                if (key % 4 == thread_index) {
+                    counts.Add(-key - 1, key);
+                }
+            }
+            });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    ASSERT_HINT(counts.Get(0) == 4 && counts.Get(4999) == 4 && counts.Get(-5000) == 4999, "Concurrent additions are lost"s);
+    ASSERT_HINT(sums.Get(7) == 100.0 && sums.Get(100) == 0.0, "Concurrent floating point additions are lost"s);
+
+    //  ,      
+    for (int key = 0; key < 5000; key += 2) {
+        counts.erase(key);
+    }
+    counts.erase(100000);
+    counts.Add(10, 3);
+    ASSERT_HINT(counts.Get(2) == 0 && counts.Get(10) == 3 && counts.Get(11) == 4, "Erase is not applied"s);
+
+    const auto pairs = counts.Drain(std::execution::seq);
+    map<int, int> expected;
+    for (int key = 0; key < 5000; ++key) {
+        if (key % 2 == 1) {
+            expected[key] = 4;
+        }
+        expected[-key - 1] = key;
+    }
+    expected[10] = 3;
+    ASSERT_HINT((map<int, int>(pairs.begin(), pairs.end()) == expected && pairs.size() == expected.size()), "Drain loses pairs"s);
+    ASSERT_HINT(counts.Get(1) == 0 && counts.Drain().empty(), "Drain does not empty the map"s);
+    counts.Add(1, 2);
+    const auto sum_map = sums.BuildOrdinaryMap();
+    ASSERT_HINT(counts.BuildOrdinaryMap() == (map<int, int>{ { 1, 2 } }) && sum_map.size() == 100 && sum_map.at(99) == 100.0,
+        "Ordinary map differs from the accumulated values"s);
+}
+
+void TestConcurrentQueriesDuringIngest() {
+    SearchServer server;
+    server.AddDocument(0, "cat city"s, DocumentStatus::ACTUAL, { 1 });
+    atomic<bool> writing = true;
+    atomic<bool> results_are_valid = true;
+    vector<thread> readers;
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&] {
+            while (writing) {
+                const auto found = server.FindTopDocuments(std::execution::par, "cat -dog"s);
+                //        :     
+                if (found.empty() || found.size() > 5 || get<0>(server.MatchDocument("cat"s, 0)).size() != 1) {
+                    results_are_valid = false;
+                }
+            }
+            });
+    }
+    vector<int> removed_ids;
+    for (int id = 1; id < 400; ++id) {
+        server.AddDocument(id, id % 2 ? "cat city"s : "cat dog"s, DocumentStatus::ACTUAL, { id });
+        if (id % 4 == 0) {
+            removed_ids.push_back(id);
+        }
+    }
+    server.RemoveDocuments(removed_ids);
+    server.CompactIndexAsync().get();
+    writing = false;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    ASSERT_HINT(results_are_valid, "Queries see an inconsistent index during writes"s);
+    ASSERT_HINT(server.GetDocumentCount() == 301, "Writes are lost"s);
+}
+
+void TestIndexSegments() {
+    const vector<string> texts = MakeCorpusTexts(200);
+    SearchServer segmented;
+    segmented.SetSegmentOptions({ 8, 2 });
+    SearchServer single;
+    for (int id = 0; id < 200; ++id) {
+        segmented.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 10 });
+        single.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 10 });
+        if (id % 9 == 0) {
+            segmented.RemoveDocument(id);
+            single.RemoveDocument(id);
+        }
+    }
+    //    ,       
+    segmented.WaitForMerges();
+    ASSERT_HINT(segmented.GetSegmentCount() > 1 && segmented.GetSegmentCount() < 12, "Segments are not merged"s);
+    const auto check_queries = [&](const string& hint) {
+        for (const string& query : { "cat -dog"s, "city park"s, "tail"s }) {
+            const auto expected = single.FindTopDocuments(query);
+            AssertSameTopDocuments(expected, segmented.FindTopDocuments(query), hint);
+            AssertSameTopDocuments(expected, segmented.FindTopDocuments(std::execution::par, query), hint);
+            ASSERT_HINT(segmented.MatchDocument(query, 199) == single.MatchDocument(query, 199), hint);
+        }
+    };
+    check_queries("Segmented index changes results"s);
+    //     ,   
+    segmented.CompactIndex();
+    check_queries("Compacted segments change results"s);
+
+    //     :    
+    //  ,      
+    SearchServer tombstoned;
+    tombstoned.SetSegmentOptions({ 100, 2 });
+    for (int id = 0; id < 20; ++id) {
+        tombstoned.AddDocument(id, CORPUS_WORDS[id % 5], DocumentStatus::ACTUAL, { id });
+        if (id == 9) {
+            tombstoned.RemoveDocuments({ 0, 5 });
+        }
+    }
+    ASSERT_HINT(tombstoned.GetSegmentCount() == 1, "Small removal batch rebuilds its segment"s);
+    ASSERT_HINT(tombstoned.GetDocumentCount() == 18 && tombstoned.FindTopDocuments("cat"s).size() == 2, "Removed documents are found"s);
+}
+
+void TestIndexSnapshot() {
+    const string path = "test_index_snapshot.bin"s;
+    const vector<string> texts = MakeCorpusTexts(150);
+    SearchServer source("and in"s);
+    source.SetSegmentOptions({ 16, 2 });
+    source.SetDocumentTextStorage(true);
+    for (int id = 0; id < 150; ++id) {
+        source.AddDocument(id, texts[id], static_cast<DocumentStatus>(id % 3), { id % 10 });
+    }
+    for (int id = 0; id < 150; id += 7) {
+        source.RemoveDocument(id);
+    }
+    source.WaitForMerges();
+    source.SaveSnapshot(path);
+
+    //     -: ,      
+    SearchServer loaded;
+    loaded.LoadSnapshot(path);
+    ASSERT_HINT(loaded.GetDocumentCount() == source.GetDocumentCount(), "Snapshot loses documents"s);
+    ASSERT_HINT(loaded.GetDocumentText(8) == source.GetDocumentText(8), "Snapshot loses document texts"s);
+    const auto check_queries = [&]() {
+        for (const string& query : { "cat -dog"s, "city park and"s, "tail"s }) {
+            AssertSameTopDocuments(source.FindTopDocuments(query), loaded.FindTopDocuments(std::execution::par, query), "Snapshot changes results"s);
+            AssertSameTopDocuments(source.FindTopDocuments(query, DocumentStatus::BANNED), loaded.FindTopDocuments(query, DocumentStatus::BANNED),
+                "Snapshot loses document statuses"s);
+            ASSERT_HINT(loaded.MatchDocument(query, 149) == source.MatchDocument(query, 149), "Snapshot changes matching"s);
+        }
+    };
+    check_queries();
+
+    //   :      
+    for (SearchServer* server : { &source, &loaded }) {
+        server->AddDocument(500, "cat owl"s, DocumentStatus::ACTUAL, { 5 });
+        server->RemoveDocuments({ 1, 2, 3 });
+    }
+    check_queries();
+    ASSERT_HINT(loaded.FindTopDocuments("owl"s).size() == 1, "Loaded server does not index new words"s);
+
+    try {
+        loaded.LoadSnapshot(path);
+        ASSERT_HINT(false, "Snapshot is loaded into a non-empty server"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ofstream(path, ios::binary | ios::trunc) << "not a snapshot"s;
+    try {
+        SearchServer broken;
+        broken.LoadSnapshot(path);
+        ASSERT_HINT(false, "Broken snapshot is loaded"s);
+    }
+    catch (const runtime_error&) {
+    }
+
+    //          ,   ,
+    //           ( )
+    SearchServer small("and"s);
+    small.SetSegmentOptions({ 4, 2 });
+    for (int id = 0; id < 12; ++id) {
+        small.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+    }
+    small.RemoveDocument(3);
+    small.WaitForMerges();
+    small.SaveSnapshot(path);
+    string bytes;
+    {
+        ifstream input(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    }
+    for (const char value : { '\x00', '\xFF' }) {
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            string corrupted = bytes;
+            corrupted[i] = value;
+            ofstream(path, ios::binary | ios::trunc) << corrupted;
+            try {
+                SearchServer damaged;
+                damaged.LoadSnapshot(path);
+                damaged.FindTopDocuments("cat city -dog"s);
+                damaged.FindTopDocuments(std::execution::par, "park tail bird"s);
+            }
+            catch (const runtime_error&) {
+            }
+        }
+    }
+    std::remove(path.c_str());
+}
+
+void TestMutationLog() {
+    const string log_path = "test_mutation_log.bin"s;
+    const string snapshot_path = "test_mutation_log_snapshot.bin"s;
+    std::remove(log_path.c_str());
+    const auto check_same = [](const SearchServer& expected, const SearchServer& actual, const string& hint) {
+        ASSERT_HINT(actual.GetDocumentCount() == expected.GetDocumentCount(), hint);
+        for (const string& query : { "cat -dog"s, "city park"s, "bird"s }) {
+            const auto expected_documents = expected.FindTopDocuments(query);
+            const auto documents = actual.FindTopDocuments(query);
+            ASSERT_HINT(documents.size() == expected_documents.size(), hint);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                ASSERT_HINT(documents[i].id == expected_documents[i].id && documents[i].rating == expected_documents[i].rating, hint);
+            }
+        }
+    };
+
+    SearchServer reference("and"s);
+    {
+        SearchServer logged("and"s);
+        logged.OpenMutationLog(log_path);
+        for (SearchServer* server : { &reference, &logged }) {
+            server->SetDocumentTextStorage(true);
+            server->AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, { 1, 2 });
+            server->AddDocuments({ { 2, "city park"s, DocumentStatus::ACTUAL, { 3 } }, { 3, "cat city"s, DocumentStatus::BANNED, {} } });
+            server->RemoveDocument(1);
+        }
+    }
+    //   
+    ofstream(log_path, ios::binary | ios::app) << "\x10\x00\x00\x00torn"s;
+    {
+        SearchServer recovered("and"s);
+        recovered.OpenMutationLog(log_path);
+        check_same(reference, recovered, "Mutation log replay loses changes"s);
+        ASSERT_HINT(recovered.GetDocumentText(2) == "city park"s, "Mutation log replay loses document texts"s);
+
+        //    
+        recovered.Checkpoint(snapshot_path);
+        for (SearchServer* server : { &reference, &recovered }) {
+            server->AddDocument(4, "park bird"s, DocumentStatus::ACTUAL, { 4 });
+            server->RemoveDocuments({ 2 });
+        }
+    }
+    {
+        SearchServer restored("and"s);
+        restored.LoadSnapshot(snapshot_path);
+        restored.OpenMutationLog(log_path);
+        check_same(reference, restored, "Snapshot and mutation log do not restore the server"s);
+        try {
+            restored.OpenMutationLog(log_path);
+            ASSERT_HINT(false, "Mutation log is opened twice"s);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+    std::remove(snapshot_path.c_str());
+    std::remove(log_path.c_str());
+
+    //    :         
+    {
+        SearchServer logged;
+        logged.OpenMutationLog(log_path);
+        for (int id = 0; id < 400; ++id) {
+            logged.AddDocument(id, id % 2 ? "cat city"s : "dog park"s, DocumentStatus::ACTUAL, { id });
+            if (id % 4 == 3) {
+                logged.RemoveDocuments({ id - 1 });
+            }
+        }
+    }
+    {
+        SearchServer recovered;
+        recovered.OpenMutationLog(log_path);
+        ASSERT_HINT(recovered.GetDocumentCount() == 300, "Replayed removals are lost"s);
+        ASSERT_HINT(recovered.GetSegmentCount() == 1, "Replayed removals rebuild segments"s);
+        ASSERT_HINT(recovered.FindTopDocuments("park"s).size() == 5 && recovered.FindTopDocuments("park -dog"s).empty(), "Replayed removals change results"s);
+    }
+    std::remove(log_path.c_str());
+}
+
+void TestCorpusLoader() {
+    const string path = "test_corpus.txt"s;
+    ofstream(path, ios::binary | ios::trunc)
+        << "1\tACTUAL\t1 2 3\tcat in the city\n"s
+        << "2\tBANNED\t\tdog in the park\r\n"s
+        << "\n"s
+        << "3\tACTUAL\t-4\tcat and dog\n"s
+        << "4\tIRRELEVANT\t5\tbird"s;
+    SearchServer server("in the and"s);
+    server.SetDocumentTextStorage(true);
+    ASSERT_HINT(LoadCorpus(server, path, { 2 }) == 4 && server.GetDocumentCount() == 4, "Corpus documents are lost"s);
+    ASSERT_HINT(server.GetDocumentText(2) == "dog in the park"s, "Corpus text is parsed incorrectly"s);
+    const auto found = server.FindTopDocuments("cat"s);
+    ASSERT_HINT(found.size() == 2 && found[0].rating + found[1].rating == -2, "Corpus ratings are parsed incorrectly"s);
+    ASSERT_HINT(server.FindTopDocuments("dog"s, DocumentStatus::BANNED).size() == 1, "Corpus statuses are parsed incorrectly"s);
+    ASSERT_HINT(server.FindTopDocuments("bird"s, DocumentStatus::IRRELEVANT).size() == 1, "Last corpus line without a newline is lost"s);
+
+    //    ,    
+    ofstream(path, ios::binary | ios::trunc)
+        << "10\tACTUAL\t1\tcat\n"s
+        << "11\tACTUAL\t1\tdog\n"s
+        << "12\tUNKNOWN\t1\tbird\n"s;
+    SearchServer partial;
+    try {
+        LoadCorpus(partial, path, { 2 });
+        ASSERT_HINT(false, "Malformed corpus line is accepted"s);
+    }
+    catch (const invalid_argument& error) {
+        ASSERT_HINT(string(error.what()).find("line 3"s) != string::npos, "Corpus error does not name the line"s);
+    }
+    ASSERT_HINT(partial.GetDocumentCount() == 2, "Batches before a malformed line are lost"s);
+    std::remove(path.c_str());
+}
+
+void TestQueryBatch() {
+    const vector<string> texts = MakeCorpusTexts(400);
+    SearchServer server("and"s);
+    server.SetSegmentOptions({ 32, 2 });
+    for (int id = 0; id < 400; ++id) {
+        server.AddDocument(id, texts[id], id % 9 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 11 - 5 });
+    }
+    server.RemoveDocuments({ 3, 50, 51, 200 });
+
+    // ,     ,       ;
+    // ,   -       
+    vector<string> queries;
+    for (int i = 0; i < 120; ++i) {
+        queries.push_back(CORPUS_WORDS[i % 6] + " "s + CORPUS_WORDS[i * 7 % 6] + (i % 4 == 0 ? " -"s + CORPUS_WORDS[(i + 2) % 6] : ""s));
+    }
+    queries.push_back(""s);
+    queries.push_back("and -cat"s);
+    queries.push_back("unknown tail"s);
+    for (const auto& results : { ProcessQueries(server, queries), server.FindTopDocumentsBatch(std::execution::seq, queries) }) {
+        ASSERT_HINT(results.size() == queries.size(), "Batch loses queries"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            AssertSameTopDocuments(server.FindTopDocuments(queries[i]), results[i], "Batch results differ from FindTopDocuments"s);
+        }
+    }
+    try {
+        server.FindTopDocumentsBatch({ "cat"s, "dog --park"s });
+        ASSERT_HINT(false, "Batch accepts an invalid query"s);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+
+void TestProcessQueriesJoined() {
+    const vector<string> texts = MakeCorpusTexts(60);
+    SearchServer server("and"s);
+    for (int id = 0; id < 60; ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 7 });
+    }
+    vector<string> queries;
+    for (int i = 0; i < 40; ++i) {
+        queries.push_back(i % 6 == 0 ? "unknown"s : CORPUS_WORDS[i % 6] + " -"s + CORPUS_WORDS[(i + 1) % 6]);
+    }
+
+    //     
+    vector<Document> expected;
+    for (const string& query : queries) {
+        for (const Document& document : server.FindTopDocuments(query)) {
+            expected.push_back(document);
+        }
+    }
+    AssertSameTopDocuments(expected, ProcessQueriesJoined(server, queries), "Joined results are out of query order"s);
+
+    vector<Document> streamed;
+    for (const Document& document : ProcessQueriesJoinedLazy(server, queries, 3)) {
+        streamed.push_back(document);
+    }
+    AssertSameTopDocuments(expected, streamed, "Lazy joined results differ"s);
+    ASSERT_HINT(ProcessQueriesJoined(server, {}).empty(), "Empty batch produces results"s);
+    auto lazy = ProcessQueriesJoinedLazy(server, { "unknown"s, "unknown"s }, 1);
+    ASSERT_HINT(lazy.begin() == lazy.end(), "Lazy results of empty queries are not empty"s);
+
+    //   :         
+    vector<Document> temporary_streamed;
+    for (const Document& document : ProcessQueriesJoinedLazy(server, { "cat"s, "bird -cat"s }, 1)) {
+        temporary_streamed.push_back(document);
+    }
+    vector<Document> temporary_expected = server.FindTopDocuments("cat"s);
+    for (const Document& document : server.FindTopDocuments("bird -cat"s)) {
+        temporary_expected.push_back(document);
+    }
+    AssertSameTopDocuments(temporary_expected, temporary_streamed, "Lazy results of temporary queries differ"s);
+}
+
 #define RUN_TEST(func)  RunTestImpl(func, #func)
 //  TestSearchServer      
 void TestSearchServer() {
@@ -165,5 +799,21 @@ void TestSearchServer() {
     RUN_TEST(TestDocumentsFiltration);
     RUN_TEST(TestDocumentsSearchByStatus);
     RUN_TEST(TestRelevanceCalculation);
+    RUN_TEST(TestRemovingDocument);
+    RUN_TEST(TestResultPagination);
+    RUN_TEST(TestAddingDocumentsBatch);
+    RUN_TEST(TestDocumentTextStorage);
+    RUN_TEST(TestDuplicateDetection);
+    RUN_TEST(TestNearDuplicates);
+    RUN_TEST(TestIndexCompaction);
+    RUN_TEST(TestRemovingDocumentsBatch);
+    RUN_TEST(TestConcurrentMap);
+    RUN_TEST(TestConcurrentQueriesDuringIngest);
+    RUN_TEST(TestIndexSegments);
+    RUN_TEST(TestIndexSnapshot);
+    RUN_TEST(TestMutationLog);
+    RUN_TEST(TestCorpusLoader);
+    RUN_TEST(TestQueryBatch);
+    RUN_TEST(TestProcessQueriesJoined);
     cerr << "Search server testing finished"s << endl;
 }
\ No newline at end of file
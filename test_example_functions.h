@@ -21,6 +21,22 @@ void TestComputeAverageRating();
 void TestDocumentsFiltration();
 void TestDocumentsSearchByStatus();
 void TestRelevanceCalculation();
+void TestRemovingDocument();
+void TestResultPagination();
+void TestAddingDocumentsBatch();
+void TestDocumentTextStorage();
+void TestDuplicateDetection();
+void TestNearDuplicates();
+void TestIndexCompaction();
+void TestRemovingDocumentsBatch();
+void TestConcurrentMap();
+void TestConcurrentQueriesDuringIngest();
+void TestIndexSegments();
+void TestIndexSnapshot();
+void TestMutationLog();
+void TestCorpusLoader();
+void TestQueryBatch();
+void TestProcessQueriesJoined();
 //     RUN_TEST       
 template <typename T>
 void RunTestImpl(const T& t, const std::string& t_str) {
@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <execution>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//Отбор K лучших элементов без полной сортировки: куча размера K, на вершине худший из отобранных.
+//is_better(lhs, rhs) - true, если lhs должен стоять в выдаче раньше rhs
+template <typename T, typename Compare>
+class TopKSelector {
+public:
+    TopKSelector(size_t k, Compare is_better)
+        : k_(k), is_better_(is_better)
+    {
+        heap_.reserve(k_);
+    }
+
+    //Добавление кандидата, O(log K)
+    void Add(T item) {
+        if (k_ == 0) {
+            return;
+        }
+        if (heap_.size() < k_) {
+            heap_.push_back(std::move(item));
+            std::push_heap(heap_.begin(), heap_.end(), is_better_);
+        }
+        else if (is_better_(item, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), is_better_);
+            heap_.back() = std::move(item);
+            std::push_heap(heap_.begin(), heap_.end(), is_better_);
+        }
+    }
+
+    //Слияние с результатом другого селектора (например, другого потока)
+    void Merge(TopKSelector&& other) {
+        for (auto& item : other.heap_) {
+            Add(std::move(item));
+        }
+        other.heap_.clear();
+    }
+
+    //Отобранные элементы, отсортированные от лучшего к худшему
+    std::vector<T> Extract() {
+        std::sort_heap(heap_.begin(), heap_.end(), is_better_);
+        return std::move(heap_);
+    }
+
+private:
+    size_t k_;
+    Compare is_better_;
+    std::vector<T> heap_;
+};
+
+//Выбор K лучших элементов диапазона за O(M log K); параллельная версия делит диапазон на части по числу ядер
+template <typename ExecutionPolicy, typename Iterator, typename Compare>
+auto SelectTopK(ExecutionPolicy&&, Iterator first, Iterator last, size_t k, Compare is_better) {
+    using Item = typename std::iterator_traits<Iterator>::value_type;
+    TopKSelector<Item, Compare> selector(k, is_better);
+
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>) {
+        const size_t size = static_cast<size_t>(std::distance(first, last));
+        const size_t part_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), size / 1024));
+        std::vector<TopKSelector<Item, Compare>> parts(part_count, TopKSelector<Item, Compare>(k, is_better));
+        std::vector<size_t> indexes(part_count);
+        for (size_t i = 0; i < part_count; ++i) {
+            indexes[i] = i;
+        }
+        std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+            auto part_begin = std::next(first, size * i / part_count);
+            const auto part_end = std::next(first, size * (i + 1) / part_count);
+            for (; part_begin != part_end; ++part_begin) {
+                parts[i].Add(*part_begin);
+            }
+            });
+        for (auto& part : parts) {
+            selector.Merge(std::move(part));
+        }
+    }
+    else {
+        for (; first != last; ++first) {
+            selector.Add(*first);
+        }
+    }
+    return selector.Extract();
+}